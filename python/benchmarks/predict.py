@@ -0,0 +1,57 @@
+# Copyright (c) 2017-present, Facebook, Inc.
+# All rights reserved.
+#
+# This source code is licensed under the MIT license found in the
+# LICENSE file in the root directory of this source tree.
+
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+from __future__ import unicode_literals
+
+from fasttext import load_model
+import os
+import time
+import argparse
+
+
+def predict(models, data, k, repeat, test, half):
+    # Typically a supervised .bin model and the .ftz files obtained by
+    # quantizing it (product quantized or -int8), to compare the dense and
+    # quantized hidden and output layers. With --half, float models are
+    # converted to fp16 or bf16 when they are loaded.
+    with open(data, "r") as f:
+        lines = [line.strip() for line in f]
+    for model in models:
+        f = load_model(model, half=half)
+        times = []
+        for _ in range(repeat):
+            t1 = time.time()
+            f.predict(lines, k=k)
+            t2 = time.time()
+            times.append(t2 - t1)
+        print(
+            "{} Predict TIME (best of {}): {} ({} us/line)".format(
+                model, repeat, min(times), 1e6 * min(times) / len(lines)
+            )
+        )
+        print("Size: {}".format(os.path.getsize(model)))
+        if test:
+            _, precision, _ = f.test(test)
+            print("P@1: {}".format(precision))
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(
+        description="Benchmark for the prediction latency of dense and quantized models."
+    )
+    parser.add_argument("data", help="A data file to predict the labels of.")
+    parser.add_argument("models", nargs="+", help="Models to compare.")
+    parser.add_argument("--test", help="A labeled file to report P@1 on.")
+    parser.add_argument("--half", choices=["fp16", "bf16"])
+    parser.add_argument("--k", default=1, type=int)
+    parser.add_argument("--repeat", default=3, type=int)
+    args = parser.parse_args()
+    predict(
+        args.models, args.data, args.k, args.repeat, args.test, args.half
+    )
@@ -0,0 +1,77 @@
+# Copyright (c) 2017-present, Facebook, Inc.
+# All rights reserved.
+#
+# This source code is licensed under the MIT license found in the
+# LICENSE file in the root directory of this source tree.
+
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+from __future__ import unicode_literals
+
+from fasttext import load_model
+import os
+import tempfile
+import time
+import argparse
+
+
+def quantize(model, dsubs, nbits, opqs, thread, repeat, test):
+    # Without cutoff and retraining, quantize is the k-means training of the
+    # product quantizer followed by the assignment of a code to every row.
+    for opq in opqs:
+        for bits in nbits:
+            for dsub in dsubs:
+                f = quantize_one(model, dsub, bits, opq, thread, repeat)
+                report(f, test)
+
+
+def quantize_one(model, dsub, nbits, opq, thread, repeat):
+    times = []
+    for _ in range(repeat):
+        f = load_model(model)
+        t1 = time.time()
+        f.quantize(dsub=dsub, nbits=nbits, opq=opq, thread=thread)
+        t2 = time.time()
+        times.append(t2 - t1)
+    print(
+        "opq {} nbits {} dsub {} Quantize TIME (best of {}): {}".format(
+            opq, nbits, dsub, repeat, min(times)
+        )
+    )
+    return f
+
+
+def report(f, test):
+    with tempfile.NamedTemporaryFile(suffix=".ftz") as tmp:
+        f.save_model(tmp.name)
+        print("Size: {}".format(os.path.getsize(tmp.name)))
+    if test:
+        _, precision, _ = f.test(test)
+        print("P@1: {}".format(precision))
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(
+        description="Benchmark for product quantization of a supervised model."
+    )
+    parser.add_argument("model", help="A supervised .bin model to quantize.")
+    parser.add_argument("--test", help="A labeled file to report P@1 on.")
+    parser.add_argument("--dsub", default=[2, 4, 8], type=int, nargs="+")
+    parser.add_argument("--nbits", default=[8], type=int, nargs="+")
+    parser.add_argument(
+        "--opq", action="store_true", help="Also quantize with a rotation."
+    )
+    parser.add_argument("--thread", default=1, type=int)
+    parser.add_argument("--repeat", default=3, type=int)
+    args = parser.parse_args()
+    opqs = [False, True] if args.opq else [False]
+    quantize(
+        args.model,
+        args.dsub,
+        args.nbits,
+        opqs,
+        args.thread,
+        args.repeat,
+        args.test,
+    )
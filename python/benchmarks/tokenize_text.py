@@ -0,0 +1,59 @@
+# Copyright (c) 2017-present, Facebook, Inc.
+# All rights reserved.
+#
+# This source code is licensed under the MIT license found in the
+# LICENSE file in the root directory of this source tree.
+
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+from __future__ import unicode_literals
+
+from fasttext import tokenize
+import time
+import argparse
+
+
+def read_chunks(data, chunk_size):
+    # Whole lines, about chunk_size bytes at a time, so that each call to
+    # tokenize goes through many buffers worth of words.
+    chunks = []
+    lines = []
+    size = 0
+    with open(data, "r", encoding="utf-8") as f:
+        for line in f:
+            lines.append(line)
+            size += len(line)
+            if size >= chunk_size:
+                chunks.append("".join(lines))
+                lines = []
+                size = 0
+    if lines:
+        chunks.append("".join(lines))
+    return chunks
+
+
+def tokenize_chunks(chunks, repeat):
+    nbytes = sum(len(chunk.encode("utf-8")) for chunk in chunks)
+    times = []
+    for _ in range(repeat):
+        ntokens = 0
+        t1 = time.time()
+        for chunk in chunks:
+            ntokens += len(tokenize(chunk))
+        t2 = time.time()
+        times.append(t2 - t1)
+    best = min(times)
+    print("Tokenize TIME (best of {}): {}".format(repeat, best))
+    print("Tokens: {} Throughput: {:.1f} MB/s".format(ntokens, nbytes / best / 1e6))
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(
+        description="Benchmark for splitting text into words, in MB/s."
+    )
+    parser.add_argument("data", help="A text file to tokenize.")
+    parser.add_argument("--chunk-size", default=1 << 20, type=int)
+    parser.add_argument("--repeat", default=3, type=int)
+    args = parser.parse_args()
+    tokenize_chunks(read_chunks(args.data, args.chunk_size), args.repeat)
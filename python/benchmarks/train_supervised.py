@@ -0,0 +1,49 @@
+# Copyright (c) 2017-present, Facebook, Inc.
+# All rights reserved.
+#
+# This source code is licensed under the MIT license found in the
+# LICENSE file in the root directory of this source tree.
+
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+from __future__ import unicode_literals
+
+from fasttext import train_supervised
+import time
+import argparse
+
+
+def train(data, epoch, dim, thread, repeat):
+    # wordNgrams=3 with char n-grams in [2, 5] produces many repeated bucket
+    # ids per example, which stresses the sparse update of the input matrix.
+    times = []
+    for _ in range(repeat):
+        t1 = time.time()
+        model = train_supervised(
+            input=data,
+            epoch=epoch,
+            dim=dim,
+            wordNgrams=3,
+            minn=2,
+            maxn=5,
+            thread=thread,
+            verbose=0,
+        )
+        t2 = time.time()
+        times.append(t2 - t1)
+    print("Train TIME (best of {}): {}".format(repeat, min(times)))
+    print("Words: {} Labels: {}".format(len(model.words), len(model.labels)))
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(
+        description="Benchmark for supervised training with word and char n-grams."
+    )
+    parser.add_argument("data", help="A training file to use for benchmarking.")
+    parser.add_argument("--epoch", default=5, type=int)
+    parser.add_argument("--dim", default=100, type=int)
+    parser.add_argument("--thread", default=1, type=int)
+    parser.add_argument("--repeat", default=3, type=int)
+    args = parser.parse_args()
+    train(args.data, args.epoch, args.dim, args.thread, args.repeat)
@@ -87,10 +87,12 @@ class _FastText:
     strings are then encoded as UTF-8 and fed to the fastText C++ API.
     """
 
-    def __init__(self, model_path=None, args=None):
+    def __init__(self, model_path=None, args=None, half=None, thread=None):
         self.f = fasttext.fasttext()
         if model_path is not None:
-            self.f.loadModel(model_path)
+            self.f.loadModel(
+                model_path, half or "", thread or multiprocessing.cpu_count()
+            )
         self._words = None
         self._labels = None
         self.set_args(args)
@@ -306,9 +308,12 @@ class _FastText:
             text = check(text)
             return self.f.getLine(text, on_unicode_error)
 
-    def save_model(self, path):
-        """Save the model to the given path"""
-        self.f.saveModel(path)
+    def save_model(self, path, compress=False):
+        """
+        Save the model to the given path. With compress, the dictionary and
+        the matrices are compressed, which load_model reads back.
+        """
+        self.f.saveModel(path, compress)
 
     def test(self, path, k=1, threshold=0.0):
         """Evaluate supervised model using file given by path"""
@@ -342,6 +347,10 @@ class _FastText:
         verbose=None,
         dsub=2,
         qnorm=False,
+        nbits=8,
+        opq=False,
+        int8=False,
+        half=None,
     ):
         """
         Quantize the model reducing the size of the model and
@@ -361,7 +370,20 @@ class _FastText:
         if input is None:
             input = ""
         self.f.quantize(
-            input, qout, cutoff, retrain, epoch, lr, thread, verbose, dsub, qnorm
+            input,
+            qout,
+            cutoff,
+            retrain,
+            epoch,
+            lr,
+            thread,
+            verbose,
+            dsub,
+            qnorm,
+            nbits,
+            opq,
+            int8,
+            half or "",
         )
 
     def set_matrices(self, input_matrix, output_matrix):
@@ -440,9 +462,16 @@ def tokenize(text):
     return f.tokenize(text)
 
 
-def load_model(path):
-    """Load a model given a filepath and return a model object."""
-    return _FastText(model_path=path)
+def load_model(path, half=None, thread=None):
+    """
+    Load a model given a filepath and return a model object.
+
+    With half set to "fp16" or "bf16", the matrices of a float model are
+    stored in half precision as they are read. The dictionary of a model
+    saved by an older version is rebuilt on thread threads (by default, one
+    per cpu) while its matrices are read.
+    """
+    return _FastText(model_path=path, half=half, thread=thread)
 
 
 unsupervised_default = {
@@ -453,6 +482,7 @@ unsupervised_default = {
     "epoch": 5,
     "minCount": 5,
     "minCountLabel": 0,
+    "vocabSketch": 0,
     "minn": 3,
     "maxn": 6,
     "neg": 5,
@@ -466,10 +496,17 @@ unsupervised_default = {
     "verbose": 2,
     "pretrainedVectors": "",
     "seed": 0,
+    "checkpoint": "",
+    "checkpointInterval": 30,
+    "checkpointTokens": 0,
+    "resume": "",
+    "inputModel": "",
     "autotuneValidationFile": "",
     "autotuneMetric": "f1",
     "autotunePredictions": 1,
     "autotuneDuration": 60 * 5,  # 5 minutes
+    "autotuneParallel": 1,
+    "autotuneEarlyStopping": False,
     "autotuneModelSize": "",
 }
 
@@ -535,6 +572,7 @@ def train_supervised(*kargs, **kwargs):
         "epoch",
         "minCount",
         "minCountLabel",
+        "vocabSketch",
         "minn",
         "maxn",
         "neg",
@@ -548,10 +586,17 @@ def train_supervised(*kargs, **kwargs):
         "verbose",
         "pretrainedVectors",
         "seed",
+        "checkpoint",
+        "checkpointInterval",
+        "checkpointTokens",
+        "resume",
+        "inputModel",
         "autotuneValidationFile",
         "autotuneMetric",
         "autotunePredictions",
         "autotuneDuration",
+        "autotuneParallel",
+        "autotuneEarlyStopping",
         "autotuneModelSize",
     ]
     args, manually_set_args = read_args(kargs, kwargs, arg_names, supervised_default)
@@ -585,6 +630,7 @@ def train_unsupervised(*kargs, **kwargs):
         "epoch",
         "minCount",
         "minCountLabel",
+        "vocabSketch",
         "minn",
         "maxn",
         "neg",
@@ -597,6 +643,11 @@ def train_unsupervised(*kargs, **kwargs):
         "label",
         "verbose",
         "pretrainedVectors",
+        "checkpoint",
+        "checkpointInterval",
+        "checkpointTokens",
+        "resume",
+        "inputModel",
     ]
     args, manually_set_args = read_args(kargs, kwargs, arg_names, unsupervised_default)
     a = _build_args(args, manually_set_args)
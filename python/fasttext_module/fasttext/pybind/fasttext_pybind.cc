@@ -97,6 +97,7 @@ PYBIND11_MODULE(fasttext_pybind, m) {
       .def_readwrite("epoch", &fasttext::Args::epoch)
       .def_readwrite("minCount", &fasttext::Args::minCount)
       .def_readwrite("minCountLabel", &fasttext::Args::minCountLabel)
+      .def_readwrite("vocabSketch", &fasttext::Args::vocabSketch)
       .def_readwrite("neg", &fasttext::Args::neg)
       .def_readwrite("wordNgrams", &fasttext::Args::wordNgrams)
       .def_readwrite("loss", &fasttext::Args::loss)
@@ -110,13 +111,25 @@ PYBIND11_MODULE(fasttext_pybind, m) {
       .def_readwrite("verbose", &fasttext::Args::verbose)
       .def_readwrite("pretrainedVectors", &fasttext::Args::pretrainedVectors)
       .def_readwrite("saveOutput", &fasttext::Args::saveOutput)
+      .def_readwrite("binaryVectors", &fasttext::Args::binaryVectors)
+      .def_readwrite("compress", &fasttext::Args::compress)
       .def_readwrite("seed", &fasttext::Args::seed)
+      .def_readwrite("checkpoint", &fasttext::Args::checkpoint)
+      .def_readwrite(
+          "checkpointInterval", &fasttext::Args::checkpointInterval)
+      .def_readwrite("checkpointTokens", &fasttext::Args::checkpointTokens)
+      .def_readwrite("resume", &fasttext::Args::resume)
+      .def_readwrite("inputModel", &fasttext::Args::inputModel)
 
       .def_readwrite("qout", &fasttext::Args::qout)
       .def_readwrite("retrain", &fasttext::Args::retrain)
       .def_readwrite("qnorm", &fasttext::Args::qnorm)
       .def_readwrite("cutoff", &fasttext::Args::cutoff)
       .def_readwrite("dsub", &fasttext::Args::dsub)
+      .def_readwrite("nbits", &fasttext::Args::nbits)
+      .def_readwrite("opq", &fasttext::Args::opq)
+      .def_readwrite("int8", &fasttext::Args::int8)
+      .def_readwrite("half", &fasttext::Args::half)
 
       .def_readwrite(
           "autotuneValidationFile", &fasttext::Args::autotuneValidationFile)
@@ -124,6 +137,9 @@ PYBIND11_MODULE(fasttext_pybind, m) {
       .def_readwrite(
           "autotunePredictions", &fasttext::Args::autotunePredictions)
       .def_readwrite("autotuneDuration", &fasttext::Args::autotuneDuration)
+      .def_readwrite("autotuneParallel", &fasttext::Args::autotuneParallel)
+      .def_readwrite(
+          "autotuneEarlyStopping", &fasttext::Args::autotuneEarlyStopping)
       .def_readwrite("autotuneModelSize", &fasttext::Args::autotuneModelSize)
       .def("setManual", [](fasttext::Args& m, const std::string& argName) {
         m.setManual(argName);
@@ -263,10 +279,15 @@ PYBIND11_MODULE(fasttext_pybind, m) {
           })
       .def(
           "loadModel",
-          [](fasttext::FastText& m, std::string s) { m.loadModel(s); })
+          [](fasttext::FastText& m,
+             std::string s,
+             std::string half,
+             int32_t thread) { m.loadModel(s, half, thread); })
       .def(
           "saveModel",
-          [](fasttext::FastText& m, std::string s) { m.saveModel(s); })
+          [](fasttext::FastText& m, std::string s, bool compress) {
+            m.saveModel(s, compress);
+          })
       .def(
           "test",
           [](fasttext::FastText& m,
@@ -310,10 +331,11 @@ PYBIND11_MODULE(fasttext_pybind, m) {
             std::vector<std::string> text_split;
             std::shared_ptr<const fasttext::Dictionary> d = m.getDictionary();
             std::stringstream ioss(text);
-            std::string token;
+            std::string storage;
+            std::string_view token;
             while (!ioss.eof()) {
-              while (d->readWord(ioss, token)) {
-                text_split.push_back(token);
+              while (d->readWord(ioss, token, storage)) {
+                text_split.emplace_back(token);
               }
             }
             return text_split;
@@ -377,7 +399,11 @@ PYBIND11_MODULE(fasttext_pybind, m) {
              int thread,
              int verbose,
              int32_t dsub,
-             bool qnorm) {
+             bool qnorm,
+             int nbits,
+             bool opq,
+             bool int8,
+             const std::string half) {
             fasttext::Args qa = fasttext::Args();
             qa.input = input;
             qa.qout = qout;
@@ -389,6 +415,18 @@ PYBIND11_MODULE(fasttext_pybind, m) {
             qa.verbose = verbose;
             qa.dsub = dsub;
             qa.qnorm = qnorm;
+            qa.nbits = nbits;
+            qa.opq = opq;
+            qa.int8 = int8;
+            qa.half = half;
+            // tells -int8 and -half apart from product quantization options
+            fasttext::Args defaults;
+            if (qa.dsub != defaults.dsub) {
+              qa.setManual("dsub");
+            }
+            if (qa.nbits != defaults.nbits) {
+              qa.setManual("nbits");
+            }
             m.quantize(qa);
           })
       .def(
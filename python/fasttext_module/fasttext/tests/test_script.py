@@ -18,6 +18,7 @@ import subprocess
 import unittest
 import tempfile
 import random
+import struct
 import sys
 import copy
 import numpy as np
@@ -130,6 +131,25 @@ def build_supervised_model(data, kwargs):
     return model
 
 
+def corrupt_compressed_block(content, section, block):
+    """
+    Gives an unknown method to a block of a compressed section of a saved
+    model, whose sections are listed after its magic number and version.
+    """
+    content = bytearray(content)
+    (count,) = struct.unpack_from("<i", content, 8)
+    for i in range(count):
+        sid, flags, offset, _ = struct.unpack_from("<IIqq", content, 12 + 24 * i)
+        if sid != section or not flags & 1:
+            continue
+        # each block is preceded by its raw and compressed sizes
+        for _ in range(block):
+            (size,) = struct.unpack_from("<I", content, offset + 4)
+            offset += 8 + size
+        content[offset + 8] = 7
+    return bytes(content)
+
+
 def read_labels(data_file):
     labels = []
     lines = []
@@ -326,6 +346,51 @@ class TestFastTextUnitPy(unittest.TestCase):
         # So the minimum length must be 1
         words = get_random_words(100, 1, 20)
         self.assertEqual(words, fasttext.tokenize(" ".join(words)))
+        # Separators other than spaces, and a newline after other separators
+        self.assertEqual(
+            ["a", "b", "c", "d", "e"], fasttext.tokenize("a\0b\vc\fd\te")
+        )
+        self.assertEqual(["a", fasttext.EOS, "b"], fasttext.tokenize("a\r\nb"))
+        self.assertEqual(
+            ["a", fasttext.EOS, fasttext.EOS], fasttext.tokenize("a \n\n")
+        )
+        self.assertEqual(
+            [fasttext.EOS, "a", fasttext.EOS, "b"], fasttext.tokenize("\na\n b")
+        )
+        # A trailing newline with and without a final word
+        self.assertEqual(["a", "b", fasttext.EOS], fasttext.tokenize("a b\n"))
+        self.assertEqual(["a", "b"], fasttext.tokenize("a b"))
+        # Words longer than the chunks separators are searched in
+        words = get_random_words(100, 1, 100)
+        self.assertEqual(words, fasttext.tokenize("\f".join(words)))
+
+        # A file is read through its stream buffer, which is refilled in the
+        # middle of the words that straddle two fillings
+        separators = [" ", "\t", "\v", "\f", "\r", "\0"]
+        lines = []
+        counts = {}
+        for _ in range(20):
+            line = get_random_words(random.randint(1, 20), 1, 10000, unique=False)
+            lines.append(
+                "".join(word + random.choice(separators) for word in line[:-1])
+                + line[-1]
+            )
+            for word in line:
+                counts[word] = counts.get(word, 0) + 1
+        for trailing_newline in [False, True]:
+            text = "\n".join(lines) + ("\n" if trailing_newline else "")
+            expected = dict(counts)
+            expected[fasttext.EOS] = len(lines) - 1 + int(trailing_newline)
+            with tempfile.NamedTemporaryFile(delete=False) as tmpf:
+                tmpf.write(text.encode("UTF-8"))
+            try:
+                f = train_unsupervised(
+                    input=tmpf.name, **default_kwargs({"maxn": 0})
+                )
+            finally:
+                os.remove(tmpf.name)
+            words, freqs = f.get_words(include_freq=True)
+            self.assertEqual(expected, dict(zip(words, map(int, freqs))))
 
     def gen_test_unsupervised_dimension(self, kwargs):
         if "dim" in kwargs:
@@ -452,6 +517,149 @@ class TestFastTextUnitPy(unittest.TestCase):
             gotError = True
         self.assertTrue(gotError)
 
+    def gen_test_save_load_compressed(self, kwargs):
+        data = get_random_data(100)
+        sentences = [" ".join(get_random_words(10)) for _ in range(10)]
+        models = [
+            (build_supervised_model(data, copy.deepcopy(kwargs)), True),
+            (build_unsupervised_model(data, copy.deepcopy(kwargs)), False),
+        ]
+        for f, supervised in models:
+            words = f.get_words() + get_random_words(20)
+            for compress in [False, True]:
+                with tempfile.NamedTemporaryFile(delete=False) as tmpf:
+                    path = tmpf.name
+                try:
+                    f.save_model(path, compress=compress)
+                    g = fasttext.load_model(path)
+                    self.assertEqual(f.get_words(), g.get_words())
+                    for word in words:
+                        np.testing.assert_array_equal(
+                            f.get_word_vector(word), g.get_word_vector(word)
+                        )
+                    if supervised:
+                        labels1, probs1 = f.predict(sentences, k=3)
+                        labels2, probs2 = g.predict(sentences, k=3)
+                        self.assertEqual(labels1, labels2)
+                        np.testing.assert_array_equal(probs1, probs2)
+
+                    with open(path, "rb") as model_file:
+                        content = model_file.read()
+                    for size in [len(content) // 2, len(content) - 3]:
+                        with open(path, "wb") as model_file:
+                            model_file.write(content[:size])
+                        with self.assertRaises(ValueError):
+                            fasttext.load_model(path)
+                    if compress:
+                        # the dictionary, input and output sections
+                        for section in [2, 3, 4]:
+                            with open(path, "wb") as model_file:
+                                model_file.write(
+                                    corrupt_compressed_block(content, section, 0)
+                                )
+                            with self.assertRaises(ValueError):
+                                fasttext.load_model(path, thread=4)
+                finally:
+                    os.remove(path)
+
+        # The blocks after the first of a section are decompressed on
+        # several threads, which must report the error rather than abort.
+        f = build_unsupervised_model(
+            data, {"dim": 100, "bucket": 10000, "minn": 2, "maxn": 3}
+        )
+        with tempfile.NamedTemporaryFile(delete=False) as tmpf:
+            path = tmpf.name
+        try:
+            f.save_model(path, compress=True)
+            with open(path, "rb") as model_file:
+                content = model_file.read()
+            with open(path, "wb") as model_file:
+                model_file.write(corrupt_compressed_block(content, 3, 2))
+            with self.assertRaises(ValueError):
+                fasttext.load_model(path, thread=4)
+        finally:
+            os.remove(path)
+
+    def gen_test_unsupervised_pretrained_vectors(self, kwargs):
+        data = get_random_data(100)
+        f = build_unsupervised_model(data, copy.deepcopy(kwargs))
+        dim = f.get_dimension()
+        words = f.get_words()
+        vectors = np.array(
+            [f.get_word_vector(word) for word in words], dtype=np.float32
+        )
+        lines = ["%d %d" % (len(words), dim)] + [
+            word + " " + " ".join("%.9g" % value for value in vector)
+            for word, vector in zip(words, vectors)
+        ]
+        # the header of .bvec files is padded to 64 bytes
+        header = struct.pack("<iiqq", 793712316, 1, len(words), dim)
+        binary = (
+            header + b"\0" * (64 - len(header)) + vectors.tobytes() +
+            b"".join(word.encode("UTF-8") + b"\0" for word in words)
+        )
+
+        def train(content, suffix, dim=dim):
+            with tempfile.NamedTemporaryFile(
+                suffix=suffix, delete=False
+            ) as tmpf:
+                tmpf.write(content)
+            try:
+                # with lr 0 the pretrained vectors are kept as they are
+                args = copy.deepcopy(kwargs)
+                args.update({"dim": dim, "lr": 0.0, "pretrainedVectors": tmpf.name})
+                return build_unsupervised_model(data, args)
+            finally:
+                os.remove(tmpf.name)
+
+        text = ("\n".join(lines) + "\n").encode("UTF-8")
+        # blank lines are skipped, wherever they are
+        blank = ("\n\n".join(lines) + "\n \n").encode("UTF-8")
+        models = [
+            train(text, ".vec"),
+            train(blank, ".vec"),
+            train(binary, ".bvec"),
+        ]
+        with tempfile.NamedTemporaryFile(delete=False) as tmpf:
+            path = tmpf.name
+        try:
+            models[2].save_model(path)
+            models.append(fasttext.load_model(path))
+        finally:
+            os.remove(path)
+        for g in models:
+            self.assertEqual(models[0].get_words(), g.get_words())
+            for word, vector in zip(words, vectors):
+                np.testing.assert_array_equal(
+                    vector, g.get_input_vector(g.get_word_id(word))
+                )
+                np.testing.assert_array_equal(
+                    models[0].get_word_vector(word), g.get_word_vector(word)
+                )
+
+        # a wrong dimension, in the header or on a line
+        for content, suffix in [(text, ".vec"), (binary, ".bvec")]:
+            with self.assertRaises(ValueError):
+                train(content, suffix, dim + 1)
+        for line in [lines[1] + " 1", lines[1].rsplit(" ", 1)[0]]:
+            content = "\n".join(lines[:1] + [line] + lines[2:]) + "\n"
+            with self.assertRaises(ValueError):
+                train(content.encode("UTF-8"), ".vec")
+
+        # truncated files, at a line or in the middle of one
+        truncated = [
+            (("\n".join(lines[:-1]) + "\n").encode("UTF-8"), ".vec"),
+            (
+                ("\n".join(lines[:-1] + [lines[-1].rsplit(" ", 1)[0]])
+                ).encode("UTF-8"), ".vec"
+            ),
+            (binary[:len(binary) - 1], ".bvec"),
+            (binary[:64 + vectors.nbytes // 2], ".bvec"),
+        ]
+        for content, suffix in truncated:
+            with self.assertRaises(ValueError):
+                train(content, suffix)
+
 
 # Generate a supervised test case
 # The returned function will be set as an attribute to a test class
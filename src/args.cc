@@ -25,6 +25,7 @@ Args::Args() {
   epoch = 5;
   minCount = 5;
   minCountLabel = 0;
+  vocabSketch = 0;
   neg = 5;
   wordNgrams = 1;
   loss = loss_name::ns;
@@ -39,18 +40,31 @@ Args::Args() {
   verbose = 2;
   pretrainedVectors = "";
   saveOutput = false;
+  binaryVectors = false;
+  compress = false;
   seed = 0;
+  checkpoint = "";
+  checkpointInterval = 30;
+  checkpointTokens = 0;
+  resume = "";
+  inputModel = "";
 
   qout = false;
   retrain = false;
   qnorm = false;
   cutoff = 0;
   dsub = 2;
+  nbits = 8;
+  opq = false;
+  int8 = false;
+  half = "";
 
   autotuneValidationFile = "";
   autotuneMetric = "f1";
   autotunePredictions = 1;
   autotuneDuration = 60 * 5; // 5 minutes
+  autotuneParallel = 1;
+  autotuneEarlyStopping = false;
   autotuneModelSize = "";
 }
 
@@ -149,6 +163,8 @@ void Args::parseArgs(const std::vector<std::string>& args) {
         minCount = std::stoi(args.at(ai + 1));
       } else if (args[ai] == "-minCountLabel") {
         minCountLabel = std::stoi(args.at(ai + 1));
+      } else if (args[ai] == "-vocabSketch") {
+        vocabSketch = std::stoi(args.at(ai + 1));
       } else if (args[ai] == "-neg") {
         neg = std::stoi(args.at(ai + 1));
       } else if (args[ai] == "-wordNgrams") {
@@ -187,8 +203,24 @@ void Args::parseArgs(const std::vector<std::string>& args) {
       } else if (args[ai] == "-saveOutput") {
         saveOutput = true;
         ai--;
+      } else if (args[ai] == "-binaryVectors") {
+        binaryVectors = true;
+        ai--;
+      } else if (args[ai] == "-compress") {
+        compress = true;
+        ai--;
       } else if (args[ai] == "-seed") {
         seed = std::stoi(args.at(ai + 1));
+      } else if (args[ai] == "-checkpoint") {
+        checkpoint = std::string(args.at(ai + 1));
+      } else if (args[ai] == "-checkpointInterval") {
+        checkpointInterval = std::stoi(args.at(ai + 1));
+      } else if (args[ai] == "-checkpointTokens") {
+        checkpointTokens = std::stoll(args.at(ai + 1));
+      } else if (args[ai] == "-resume") {
+        resume = std::string(args.at(ai + 1));
+      } else if (args[ai] == "-inputModel") {
+        inputModel = std::string(args.at(ai + 1));
       } else if (args[ai] == "-qnorm") {
         qnorm = true;
         ai--;
@@ -202,6 +234,21 @@ void Args::parseArgs(const std::vector<std::string>& args) {
         cutoff = std::stoi(args.at(ai + 1));
       } else if (args[ai] == "-dsub") {
         dsub = std::stoi(args.at(ai + 1));
+      } else if (args[ai] == "-nbits") {
+        nbits = std::stoi(args.at(ai + 1));
+      } else if (args[ai] == "-opq") {
+        opq = true;
+        ai--;
+      } else if (args[ai] == "-int8") {
+        int8 = true;
+        ai--;
+      } else if (args[ai] == "-half") {
+        half = std::string(args.at(ai + 1));
+        if (half != "fp16" && half != "bf16") {
+          std::cerr << "Unknown half precision format: " << half << std::endl;
+          printHelp();
+          exit(EXIT_FAILURE);
+        }
       } else if (args[ai] == "-autotune-validation") {
         autotuneValidationFile = std::string(args.at(ai + 1));
       } else if (args[ai] == "-autotune-metric") {
@@ -212,6 +259,11 @@ void Args::parseArgs(const std::vector<std::string>& args) {
         autotunePredictions = std::stoi(args.at(ai + 1));
       } else if (args[ai] == "-autotune-duration") {
         autotuneDuration = std::stoi(args.at(ai + 1));
+      } else if (args[ai] == "-autotune-parallel") {
+        autotuneParallel = std::stoi(args.at(ai + 1));
+      } else if (args[ai] == "-autotune-early-stopping") {
+        autotuneEarlyStopping = true;
+        ai--;
       } else if (args[ai] == "-autotune-modelsize") {
         autotuneModelSize = std::string(args.at(ai + 1));
       } else {
@@ -265,7 +317,11 @@ void Args::printDictionaryHelp() {
             << "  -maxn               max length of char ngram [" << maxn
             << "]\n"
             << "  -t                  sampling threshold [" << t << "]\n"
-            << "  -label              labels prefix [" << label << "]\n";
+            << "  -label              labels prefix [" << label << "]\n"
+            << "  -vocabSketch        MB of the count-min sketch counting "
+               "words until they reach minCount, 0 to count all words "
+               "exactly ["
+            << vocabSketch << "]\n";
 }
 
 void Args::printTrainingHelp() {
@@ -289,7 +345,24 @@ void Args::printTrainingHelp() {
       << pretrainedVectors << "]\n"
       << "  -saveOutput         whether output params should be saved ["
       << boolToString(saveOutput) << "]\n"
-      << "  -seed               random generator seed  [" << seed << "]\n";
+      << "  -binaryVectors      whether word vectors are saved as binary .bvec "
+         "instead of .vec ["
+      << boolToString(binaryVectors) << "]\n"
+      << "  -compress           whether the saved model is compressed ["
+      << boolToString(compress) << "]\n"
+      << "  -seed               random generator seed  [" << seed << "]\n"
+      << "  -checkpoint         path of the checkpoint saved during training ["
+      << checkpoint << "]\n"
+      << "  -checkpointInterval minutes between checkpoints ["
+      << checkpointInterval << "]\n"
+      << "  -checkpointTokens   tokens between checkpoints, 0 to only use the "
+         "interval ["
+      << checkpointTokens << "]\n"
+      << "  -resume             checkpoint to resume training from ["
+      << resume << "]\n"
+      << "  -inputModel         model to train further on the input, adding "
+         "its new words and labels ["
+      << inputModel << "]\n";
 }
 
 void Args::printAutotuneHelp() {
@@ -304,6 +377,12 @@ void Args::printAutotuneHelp() {
             << autotunePredictions << "]\n"
             << "  -autotune-duration              maximum duration in seconds ["
             << autotuneDuration << "]\n"
+            << "  -autotune-parallel              number of trials trained "
+               "concurrently, sharing the threads ["
+            << autotuneParallel << "]\n"
+            << "  -autotune-early-stopping        stop trials scoring below the "
+               "median of previous trials ["
+            << boolToString(autotuneEarlyStopping) << "]\n"
             << "  -autotune-modelsize             constraint model file size ["
             << autotuneModelSize << "] (empty = do not quantize)\n";
 }
@@ -320,7 +399,18 @@ void Args::printQuantizationHelp() {
       << boolToString(qnorm) << "]\n"
       << "  -qout               whether the classifier is quantized ["
       << boolToString(qout) << "]\n"
-      << "  -dsub               size of each sub-vector [" << dsub << "]\n";
+      << "  -dsub               size of each sub-vector [" << dsub << "]\n"
+      << "  -nbits              bits per sub-vector code, 4 or 8 [" << nbits
+      << "]\n"
+      << "  -opq                whether the embeddings are rotated before "
+         "quantization ["
+      << boolToString(opq) << "]\n"
+      << "  -int8               whether values are stored as int8 with a scale "
+         "per row instead of product quantized ["
+      << boolToString(int8) << "]\n"
+      << "  -half               store values as 16 bit floats instead, fp16 or "
+         "bf16 ["
+      << half << "]\n";
 }
 
 void Args::save(std::ostream& out) {
@@ -8,6 +8,7 @@
 
 #pragma once
 
+#include <cstdint>
 #include <istream>
 #include <ostream>
 #include <string>
@@ -45,6 +46,7 @@ class Args {
   int epoch;
   int minCount;
   int minCountLabel;
+  int vocabSketch;
   int neg;
   int wordNgrams;
   loss_name loss;
@@ -58,18 +60,31 @@ class Args {
   int verbose;
   std::string pretrainedVectors;
   bool saveOutput;
+  bool binaryVectors;
+  bool compress;
   int seed;
+  std::string checkpoint;
+  int checkpointInterval;
+  int64_t checkpointTokens;
+  std::string resume;
+  std::string inputModel;
 
   bool qout;
   bool retrain;
   bool qnorm;
   size_t cutoff;
   size_t dsub;
+  int nbits;
+  bool opq;
+  bool int8;
+  std::string half;
 
   std::string autotuneValidationFile;
   std::string autotuneMetric;
   int autotunePredictions;
   int autotuneDuration;
+  int autotuneParallel;
+  bool autotuneEarlyStopping;
   std::string autotuneModelSize;
 
   void parseArgs(const std::vector<std::string>& args);
@@ -13,6 +13,7 @@
 #include <functional>
 #include <iomanip>
 #include <iostream>
+#include <iterator>
 #include <random>
 #include <thread>
 
@@ -58,6 +59,10 @@ namespace fasttext {
 
 constexpr double kUnknownBestScore = -1.0;
 constexpr int kCutoffLimit = 256;
+// numbers of epochs after which early stopping evaluates a longer trial
+constexpr int kEarlyStoppingCheckpoints[] = {1, 2, 4, 8, 16, 32, 64};
+constexpr size_t kEarlyStoppingMinTrials = 3;
+constexpr int64_t kEarlyStoppingSampleSize = 1000;
 
 template <typename T>
 T getArgGauss(
@@ -205,6 +210,107 @@ void AutotuneStrategy::updateBest(const Args& args) {
   }
 }
 
+AutotuneCache::AutotuneCache(
+    const std::string& validationFile,
+    int64_t validationSampleSize)
+    : validationFile_(validationFile),
+      validationSampleSize_(validationSampleSize),
+      vocabulary_(),
+      vocabularyKey_(),
+      entries_(),
+      mutex_(),
+      vocabularyMutex_() {}
+
+AutotuneCache::Key AutotuneCache::getKey(const Args& args) {
+  return Key(
+      args.minCount,
+      args.minCountLabel,
+      args.bucket,
+      args.minn,
+      args.maxn,
+      args.wordNgrams);
+}
+
+std::shared_ptr<const Dictionary> AutotuneCache::getVocabulary(
+    const Args& args) {
+  std::lock_guard<std::mutex> lock(vocabularyMutex_);
+  std::pair<int, int> key(args.minCount, args.minCountLabel);
+  if (!vocabulary_ || vocabularyKey_ != key) {
+    std::ifstream ifs(args.input);
+    if (!ifs.is_open()) {
+      throw std::invalid_argument(
+          args.input + " cannot be opened for training!");
+    }
+    vocabulary_.reset();
+    vocabulary_ = std::make_shared<Dictionary>(std::make_shared<Args>(args));
+    vocabulary_->readFromFile(ifs);
+    vocabularyKey_ = key;
+  }
+  return vocabulary_;
+}
+
+AutotuneCache::Entry AutotuneCache::get(const Args& args) {
+  Key key = getKey(args);
+  std::promise<Entry> promise;
+  std::shared_future<Entry> entry;
+  bool building = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = std::find_if(
+        entries_.begin(),
+        entries_.end(),
+        [&key](const std::pair<Key, std::shared_future<Entry>>& cached) {
+          return cached.first == key;
+        });
+    if (it != entries_.end()) {
+      entries_.splice(entries_.begin(), entries_, it);
+      entry = it->second;
+    } else {
+      if (entries_.size() >= kMaxEntries) {
+        entries_.pop_back();
+      }
+      entry = promise.get_future().share();
+      entries_.emplace_front(key, entry);
+      building = true;
+    }
+  }
+  if (building) {
+    try {
+      promise.set_value(build(args));
+    } catch (...) {
+      // the trials waiting for the entry get the error, the next ones retry
+      promise.set_exception(std::current_exception());
+      std::lock_guard<std::mutex> lock(mutex_);
+      entries_.remove_if(
+          [&key](const std::pair<Key, std::shared_future<Entry>>& cached) {
+            return cached.first == key;
+          });
+    }
+  }
+  return entry.get();
+}
+
+AutotuneCache::Entry AutotuneCache::build(const Args& args) {
+  auto dict = std::make_shared<Dictionary>(
+      std::make_shared<Args>(args), *getVocabulary(args));
+  std::ifstream trainStream(args.input);
+  std::ifstream validationStream(validationFile_);
+  if (!trainStream.is_open() || !validationStream.is_open()) {
+    throw std::invalid_argument("Autotune files cannot be opened!");
+  }
+  Entry entry;
+  entry.train = std::make_shared<Corpus>(dict, trainStream);
+  entry.validation = std::make_shared<Corpus>(dict, validationStream);
+  if (validationSampleSize_ > 0) {
+    int64_t stride = std::max(
+        int64_t(1), entry.validation->nrecords() / validationSampleSize_);
+    utils::seek(validationStream, 0);
+    entry.validationSample =
+        std::make_shared<Corpus>(dict, validationStream, stride);
+  }
+  return entry;
+}
+
 Autotune::Autotune(const std::shared_ptr<FastText>& fastText)
     : fastText_(fastText),
       elapsed_(0.),
@@ -213,6 +319,12 @@ Autotune::Autotune(const std::shared_ptr<FastText>& fastText)
       sizeConstraintFailed_(0),
       continueTraining_(false),
       strategy_(),
+      cache_(),
+      bestTrainArgs_(),
+      sizeConstraintWarning_(false),
+      trainers_({fastText}),
+      checkpointScores_(),
+      mutex_(),
       timer_() {}
 
 void Autotune::printInfo(double maxDuration) {
@@ -252,19 +364,21 @@ bool Autotune::keepTraining(double maxDuration) const {
 }
 
 void Autotune::abort() {
-  if (continueTraining_) {
-    continueTraining_ = false;
-    fastText_->abort();
+  if (continueTraining_.exchange(false)) {
+    for (const auto& fastText : trainers_) {
+      fastText->abort();
+    }
   }
 }
 
 void Autotune::startTimer(const Args& args) {
   std::chrono::steady_clock::time_point start =
       std::chrono::steady_clock::now();
-  timer_ = std::thread([=]() { timer(start, args.autotuneDuration); });
   bestScore_ = kUnknownBestScore;
   trials_ = 0;
+  // set before the timer starts, which stops as soon as it reads false
   continueTraining_ = true;
+  timer_ = std::thread([=]() { timer(start, args.autotuneDuration); });
 
   auto previousSignalHandler = std::signal(SIGINT, signalHandler);
   interruptSignalHandler = [&]() {
@@ -275,6 +389,7 @@ void Autotune::startTimer(const Args& args) {
 }
 
 double Autotune::getMetricScore(
+    const FastText& fastText,
     Meter& meter,
     const metric_name& metricName,
     const double metricValue,
@@ -282,7 +397,7 @@ double Autotune::getMetricScore(
   double score = 0.0;
   int32_t labelId = -1;
   if (!metricLabel.empty()) {
-    labelId = fastText_->getLabelId(metricLabel);
+    labelId = fastText.getLabelId(metricLabel);
     if (labelId == -1) {
       throw std::runtime_error("Unknown autotune metric label");
     }
@@ -319,44 +434,60 @@ void Autotune::printArgs(const Args& args, const Args& autotuneArgs) {
 }
 
 int Autotune::getCutoffForFileSize(
+    const FastText& fastText,
     bool qout,
     bool qnorm,
     int dsub,
+    int nbits,
+    bool opq,
     int64_t fileSize) const {
   int64_t outModelSize = 0;
-  const int64_t outM = fastText_->getOutputMatrix()->size(0);
-  const int64_t outN = fastText_->getOutputMatrix()->size(1);
+  const int64_t outM = fastText.getOutputMatrix()->size(0);
+  const int64_t outN = fastText.getOutputMatrix()->size(1);
   if (qout) {
-    const int64_t outputPqSize = 16 + 4 * (outN * (1 << 8));
-    outModelSize =
-        21 + (outM * ((outN + 2 - 1) / 2)) + outputPqSize + (qnorm ? outM : 0);
+    const int64_t outputPqSize = 16 + 4 * (outN * (1 << nbits));
+    const int64_t outCodeSize = (((outN + 2 - 1) / 2) * nbits + 7) / 8;
+    outModelSize = 21 + (outM * outCodeSize) + outputPqSize +
+        (qnorm ? outM : 0) + (nbits != 8 ? 4 : 0);
   } else {
     outModelSize = 16 + 4 * (outM * outN);
   }
-  const int64_t dim = fastText_->getInputMatrix()->size(1);
+  const int64_t dim = fastText.getInputMatrix()->size(1);
 
-  int target = (fileSize - (107) - 4 * (1 << 8) * dim - outModelSize);
-  int cutoff = target / ((dim + dsub - 1) / dsub + (qnorm ? 1 : 0) + 10);
+  const int64_t rotationSize = opq ? 16 + 4 * dim * dim : 0;
+  int target = (fileSize - (107) - 4 * (1 << nbits) * dim - outModelSize -
+                rotationSize);
+  int codeSize = (((dim + dsub - 1) / dsub) * nbits + 7) / 8;
+  int cutoff = target / (codeSize + (qnorm ? 1 : 0) + 10);
 
   return std::max(cutoff, kCutoffLimit);
 }
 
-bool Autotune::quantize(Args& args, const Args& autotuneArgs) {
+bool Autotune::quantize(
+    FastText& fastText,
+    Args& args,
+    const Args& autotuneArgs) {
   if (autotuneArgs.getAutotuneModelSize() == Args::kUnlimitedModelSize) {
     return true;
   }
-  auto outputSize = fastText_->getOutputMatrix()->size(0);
+  auto outputSize = fastText.getOutputMatrix()->size(0);
 
   args.qnorm = true;
   args.qout = (outputSize >= kCutoffLimit);
   args.retrain = true;
   args.cutoff = getCutoffForFileSize(
-      args.qout, args.qnorm, args.dsub, autotuneArgs.getAutotuneModelSize());
+      fastText,
+      args.qout,
+      args.qnorm,
+      args.dsub,
+      args.nbits,
+      args.opq,
+      autotuneArgs.getAutotuneModelSize());
   LOG_VAL(cutoff, args.cutoff);
   if (args.cutoff == kCutoffLimit) {
     return false;
   }
-  fastText_->quantize(args);
+  fastText.quantize(args);
 
   return true;
 }
@@ -380,55 +511,141 @@ void Autotune::printSkippedArgs(const Args& autotuneArgs) {
   }
 }
 
-void Autotune::train(const Args& autotuneArgs) {
+// Median stopping rule: a trial is stopped at a checkpoint when its score is
+// below the median score of the earlier trials that reached that checkpoint.
+// As checkpoints are numbers of epochs, only trials that are longer than a
+// checkpoint are compared there, like the rungs of successive halving.
+bool Autotune::isBelowMedian(size_t checkpoint, double score) {
+  if (std::isnan(score)) {
+    score = 0.0;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<double>& scores = checkpointScores_[checkpoint];
+  bool below = false;
+  if (scores.size() >= kEarlyStoppingMinTrials) {
+    std::vector<double> sorted(scores);
+    auto median = sorted.begin() + sorted.size() / 2;
+    std::nth_element(sorted.begin(), median, sorted.end());
+    below = score < *median;
+  }
+  // stopped trials count too, or the median would only ever rise
+  scores.push_back(score);
+  return below;
+}
+
+FastText::TrainCallback Autotune::getEarlyStoppingCallback(
+    const Args& autotuneArgs,
+    const Args& trainArgs,
+    const std::shared_ptr<FastText>& fastText,
+    const std::shared_ptr<Corpus>& validationSample,
+    std::atomic<bool>& stopped) {
+  auto nextCheckpoint = std::make_shared<std::atomic<size_t>>(0);
+  const int epoch = trainArgs.epoch;
+  return [=, &autotuneArgs, &stopped](
+             float progress, float, double, double, int64_t) {
+    size_t checkpoint = *nextCheckpoint;
+    if (checkpoint >= std::size(kEarlyStoppingCheckpoints) ||
+        kEarlyStoppingCheckpoints[checkpoint] >= epoch ||
+        progress * epoch < kEarlyStoppingCheckpoints[checkpoint] ||
+        !nextCheckpoint->compare_exchange_strong(checkpoint, checkpoint + 1)) {
+      return;
+    }
+    // evaluated by one training thread while the others keep going
+    const auto& metricLabel = autotuneArgs.getAutotuneMetricLabel();
+    Meter meter(!metricLabel.empty());
+    fastText->test(
+        *validationSample, autotuneArgs.autotunePredictions, 0.0, meter);
+    double score = getMetricScore(
+        *fastText,
+        meter,
+        autotuneArgs.getAutotuneMetric(),
+        autotuneArgs.getAutotuneMetricValue(),
+        metricLabel);
+    if (isBelowMedian(checkpoint, score)) {
+      stopped = true;
+      fastText->abort();
+    }
+  };
+}
+
+void Autotune::trainTrials(
+    const Args& autotuneArgs,
+    const std::shared_ptr<FastText>& fastText,
+    int thread) {
   std::ifstream validationFileStream(autotuneArgs.autotuneValidationFile);
   if (!validationFileStream.is_open()) {
     throw std::invalid_argument("Validation file cannot be opened!");
   }
-  printSkippedArgs(autotuneArgs);
-
-  bool sizeConstraintWarning = false;
-  int verbose = autotuneArgs.verbose;
-  Args bestTrainArgs(autotuneArgs);
-  Args trainArgs(autotuneArgs);
-  trainArgs.verbose = 0;
-  strategy_ = std::unique_ptr<AutotuneStrategy>(
-      new AutotuneStrategy(trainArgs, autotuneArgs.seed));
-  startTimer(autotuneArgs);
 
   while (keepTraining(autotuneArgs.autotuneDuration)) {
-    trials_++;
-
-    trainArgs = strategy_->ask(elapsed_);
-    LOG_VAL(Trial, trials_)
-    printArgs(trainArgs, autotuneArgs);
+    Args trainArgs;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      trials_++;
+      trainArgs = strategy_->ask(elapsed_);
+      trainArgs.thread = thread;
+      LOG_VAL(Trial, trials_)
+      printArgs(trainArgs, autotuneArgs);
+    }
     ElapsedTimeMarker elapsedTimeMarker;
     double currentScore = std::numeric_limits<double>::quiet_NaN();
+    std::atomic<bool> stopped(false);
     try {
-      fastText_->train(trainArgs);
-      bool sizeConstraintOK = quantize(trainArgs, autotuneArgs);
+      AutotuneCache::Entry cached;
+      if (cache_) {
+        cached = cache_->get(trainArgs);
+        // FastText::train clears an abort that came while the trial was
+        // waiting for its entry
+        if (!keepTraining(autotuneArgs.autotuneDuration)) {
+          break;
+        }
+        FastText::TrainCallback callback;
+        if (cached.validationSample) {
+          callback = getEarlyStoppingCallback(
+              autotuneArgs,
+              trainArgs,
+              fastText,
+              cached.validationSample,
+              stopped);
+        }
+        fastText->train(trainArgs, cached.train, callback);
+      } else {
+        fastText->train(trainArgs);
+      }
+      bool sizeConstraintOK = quantize(*fastText, trainArgs, autotuneArgs);
       if (sizeConstraintOK) {
         const auto& metricLabel = autotuneArgs.getAutotuneMetricLabel();
         Meter meter(!metricLabel.empty());
-        fastText_->test(
-            validationFileStream, autotuneArgs.autotunePredictions, 0.0, meter);
+        if (cached.validation && !fastText->isQuant()) {
+          fastText->test(
+              *cached.validation, autotuneArgs.autotunePredictions, 0.0, meter);
+        } else {
+          fastText->test(
+              validationFileStream,
+              autotuneArgs.autotunePredictions,
+              0.0,
+              meter);
+        }
 
         currentScore = getMetricScore(
+            *fastText,
             meter,
             autotuneArgs.getAutotuneMetric(),
             autotuneArgs.getAutotuneMetricValue(),
             metricLabel);
 
+        std::lock_guard<std::mutex> lock(mutex_);
         if (bestScore_ == kUnknownBestScore || (currentScore > bestScore_)) {
-          bestTrainArgs = trainArgs;
+          bestTrainArgs_ = trainArgs;
           bestScore_ = currentScore;
-          strategy_->updateBest(bestTrainArgs);
+          strategy_->updateBest(bestTrainArgs_);
         }
       } else {
+        std::lock_guard<std::mutex> lock(mutex_);
         sizeConstraintFailed_++;
-        if (!sizeConstraintWarning && trials_ > 10 &&
+        if (!sizeConstraintWarning_ && trials_ > 10 &&
             sizeConstraintFailed_ > (trials_ / 2)) {
-          sizeConstraintWarning = true;
+          sizeConstraintWarning_ = true;
           std::cerr << std::endl
                     << "Warning : requested model size is probably too small. "
                        "You may want to increase `autotune-modelsize`."
@@ -442,18 +659,104 @@ void Autotune::train(const Args& autotuneArgs) {
     } catch (TimeoutError&) {
       break;
     } catch (FastText::AbortError&) {
-      break;
+      if (!stopped) {
+        break;
+      }
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopped) {
+      LOG_VAL(stopped early, 1)
     }
     LOG_VAL_NAN(currentScore, currentScore)
     LOG_VAL(train took, elapsedTimeMarker.getElapsed())
   }
+}
+
+void Autotune::train(const Args& autotuneArgs) {
+  std::ifstream validationFileStream(autotuneArgs.autotuneValidationFile);
+  if (!validationFileStream.is_open()) {
+    throw std::invalid_argument("Validation file cannot be opened!");
+  }
+  validationFileStream.close();
+  if (!autotuneArgs.checkpoint.empty() || !autotuneArgs.resume.empty()) {
+    throw std::invalid_argument("Checkpoints cannot be used with autotune!");
+  }
+  if (!autotuneArgs.inputModel.empty()) {
+    throw std::invalid_argument("An input model cannot be autotuned!");
+  }
+  if (autotuneArgs.getAutotuneModelSize() != Args::kUnlimitedModelSize &&
+      (autotuneArgs.int8 || !autotuneArgs.half.empty())) {
+    throw std::invalid_argument(
+        "-autotune-modelsize product quantizes the model, it cannot be used "
+        "with -int8 or -half!");
+  }
+  printSkippedArgs(autotuneArgs);
+
+  int verbose = autotuneArgs.verbose;
+  Args trainArgs(autotuneArgs);
+  trainArgs.verbose = 0;
+  bestTrainArgs_ = autotuneArgs;
+  sizeConstraintWarning_ = false;
+  strategy_ = std::unique_ptr<AutotuneStrategy>(
+      new AutotuneStrategy(trainArgs, autotuneArgs.seed));
+  // a preprocessed corpus already has its dictionary, and pretrained vectors
+  // modify the dictionary of each trial
+  if (!Corpus::isCorpus(autotuneArgs.input) &&
+      autotuneArgs.pretrainedVectors.empty()) {
+    cache_ = std::unique_ptr<AutotuneCache>(new AutotuneCache(
+        autotuneArgs.autotuneValidationFile,
+        autotuneArgs.autotuneEarlyStopping ? kEarlyStoppingSampleSize : 0));
+  }
+  checkpointScores_.assign(std::size(kEarlyStoppingCheckpoints), {});
+
+  // each concurrent trial gets its own model and a share of the threads
+  int parallel = std::max(1, autotuneArgs.autotuneParallel);
+  int thread = std::max(1, autotuneArgs.thread / parallel);
+  trainers_ = {fastText_};
+  for (int i = 1; i < parallel; i++) {
+    trainers_.push_back(std::make_shared<FastText>());
+  }
+  startTimer(autotuneArgs);
+
+  if (parallel > 1) {
+    std::vector<std::thread> workers;
+    std::exception_ptr workerException;
+    for (int i = 0; i < parallel; i++) {
+      workers.push_back(std::thread([&, i]() {
+        try {
+          trainTrials(autotuneArgs, trainers_[i], thread);
+        } catch (...) {
+          {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!workerException) {
+              workerException = std::current_exception();
+            }
+          }
+          // stop the other trials once one worker failed
+          abort();
+        }
+      }));
+    }
+    for (auto& worker : workers) {
+      worker.join();
+    }
+    if (workerException) {
+      if (timer_.joinable()) {
+        timer_.join();
+      }
+      std::rethrow_exception(workerException);
+    }
+  } else {
+    trainTrials(autotuneArgs, fastText_, autotuneArgs.thread);
+  }
   if (timer_.joinable()) {
     timer_.join();
   }
+  trainers_ = {fastText_};
 
   if (bestScore_ == kUnknownBestScore) {
     std::string errorMessage;
-    if (sizeConstraintWarning) {
+    if (sizeConstraintWarning_) {
       errorMessage =
           "Couldn't fulfil model size constraint: please increase "
           "`autotune-modelsize`.";
@@ -466,11 +769,18 @@ void Autotune::train(const Args& autotuneArgs) {
   } else {
     std::cerr << std::endl;
     std::cerr << "Training again with best arguments" << std::endl;
+    Args bestTrainArgs(bestTrainArgs_);
     bestTrainArgs.verbose = verbose;
+    bestTrainArgs.thread = autotuneArgs.thread;
     LOG_VAL(Best selected args, 0)
     printArgs(bestTrainArgs, autotuneArgs);
-    fastText_->train(bestTrainArgs);
-    quantize(bestTrainArgs, autotuneArgs);
+    if (cache_) {
+      fastText_->train(bestTrainArgs, cache_->get(bestTrainArgs).train);
+    } else {
+      fastText_->train(bestTrainArgs);
+    }
+    cache_.reset();
+    quantize(*fastText_, bestTrainArgs, autotuneArgs);
   }
 }
 
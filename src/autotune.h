@@ -8,10 +8,15 @@
 
 #pragma once
 
+#include <future>
 #include <istream>
+#include <list>
 #include <memory>
+#include <mutex>
 #include <random>
 #include <thread>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 #include "args.h"
@@ -40,6 +45,45 @@ class AutotuneStrategy {
   void updateBest(const Args& args);
 };
 
+/**
+ * Keeps what trials with the same dictionary arguments have in common: the
+ * word counts read from the training file, and the dictionary with the
+ * training and validation sets tokenized in memory for the most recently
+ * used arguments. An entry is built by the first trial that asks for it,
+ * without holding the lock, while the trials asking for the same arguments
+ * wait for it and the others go on.
+ */
+class AutotuneCache {
+ public:
+  struct Entry {
+    std::shared_ptr<Corpus> train;
+    std::shared_ptr<Corpus> validation;
+    std::shared_ptr<Corpus> validationSample;
+  };
+
+ private:
+  using Key = std::tuple<int, int, int, int, int, int>;
+  static const size_t kMaxEntries = 2;
+
+  std::string validationFile_;
+  int64_t validationSampleSize_;
+  std::shared_ptr<Dictionary> vocabulary_;
+  std::pair<int, int> vocabularyKey_;
+  std::list<std::pair<Key, std::shared_future<Entry>>> entries_;
+  std::mutex mutex_;
+  std::mutex vocabularyMutex_;
+
+  static Key getKey(const Args& args);
+  std::shared_ptr<const Dictionary> getVocabulary(const Args& args);
+  Entry build(const Args& args);
+
+ public:
+  explicit AutotuneCache(
+      const std::string& validationFile,
+      int64_t validationSampleSize = 0);
+  Entry get(const Args& args);
+};
+
 class Autotune {
  protected:
   std::shared_ptr<FastText> fastText_;
@@ -49,6 +93,12 @@ class Autotune {
   int32_t sizeConstraintFailed_;
   std::atomic<bool> continueTraining_;
   std::unique_ptr<AutotuneStrategy> strategy_;
+  std::unique_ptr<AutotuneCache> cache_;
+  Args bestTrainArgs_;
+  bool sizeConstraintWarning_;
+  std::vector<std::shared_ptr<FastText>> trainers_;
+  std::vector<std::vector<double>> checkpointScores_;
+  std::mutex mutex_;
   std::thread timer_;
 
   bool keepTraining(double maxDuration) const;
@@ -59,15 +109,33 @@ class Autotune {
   void abort();
   void startTimer(const Args& args);
   double getMetricScore(
+      const FastText& fastText,
       Meter& meter,
       const metric_name& metricName,
       const double metricValue,
       const std::string& metricLabel) const;
   void printArgs(const Args& args, const Args& autotuneArgs);
   void printSkippedArgs(const Args& autotuneArgs);
-  bool quantize(Args& args, const Args& autotuneArgs);
-  int getCutoffForFileSize(bool qout, bool qnorm, int dsub, int64_t fileSize)
-      const;
+  bool quantize(FastText& fastText, Args& args, const Args& autotuneArgs);
+  int getCutoffForFileSize(
+      const FastText& fastText,
+      bool qout,
+      bool qnorm,
+      int dsub,
+      int nbits,
+      bool opq,
+      int64_t fileSize) const;
+  bool isBelowMedian(size_t checkpoint, double score);
+  FastText::TrainCallback getEarlyStoppingCallback(
+      const Args& autotuneArgs,
+      const Args& trainArgs,
+      const std::shared_ptr<FastText>& fastText,
+      const std::shared_ptr<Corpus>& validationSample,
+      std::atomic<bool>& stopped);
+  void trainTrials(
+      const Args& autotuneArgs,
+      const std::shared_ptr<FastText>& fastText,
+      int thread);
 
   class TimeoutError : public std::runtime_error {
    public:
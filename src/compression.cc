@@ -0,0 +1,526 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "compression.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <stdexcept>
+
+#include "utils.h"
+
+namespace fasttext {
+
+constexpr int32_t kPlanes = 4;
+constexpr int32_t kMaxCodeLength = 12;
+constexpr uint8_t kStoredBlock = 0;
+constexpr uint8_t kPlanesBlock = 1;
+constexpr uint8_t kStoredPlane = 0;
+constexpr uint8_t kHuffmanPlane = 1;
+// a coded plane is split in streams, which are decoded together
+constexpr int32_t kStreams = 4;
+// the method of a plane, its code lengths and the sizes of its streams
+constexpr size_t kMaxPlaneOverhead = 1 + 256 + kStreams * sizeof(uint32_t);
+constexpr size_t kMaxBlockOverhead = 1 + kPlanes * kMaxPlaneOverhead;
+
+void throwInvalidBlock() {
+  throw std::invalid_argument("Invalid compressed block!");
+}
+
+// Lengths of a Huffman code for the counts. Codes longer than kMaxCodeLength
+// are avoided by halving the counts until there are none.
+void buildCodeLengths(std::vector<uint64_t> counts, uint8_t* lengths) {
+  while (true) {
+    std::fill(lengths, lengths + 256, 0);
+    using Node = std::pair<uint64_t, int32_t>;
+    std::priority_queue<Node, std::vector<Node>, std::greater<Node>> heap;
+    for (int32_t i = 0; i < 256; i++) {
+      if (counts[i] > 0) {
+        heap.push({counts[i], i});
+      }
+    }
+    if (heap.size() == 1) {
+      lengths[heap.top().second] = 1;
+      return;
+    }
+    // nodes below 256 are the symbols, the others merge two nodes
+    std::vector<int32_t> parent(2 * 256, -1);
+    int32_t next = 256;
+    while (heap.size() > 1) {
+      Node first = heap.top();
+      heap.pop();
+      Node second = heap.top();
+      heap.pop();
+      parent[first.second] = next;
+      parent[second.second] = next;
+      heap.push({first.first + second.first, next++});
+    }
+    int32_t maxLength = 0;
+    for (int32_t i = 0; i < 256; i++) {
+      if (counts[i] > 0) {
+        int32_t length = 0;
+        for (int32_t node = i; parent[node] >= 0; node = parent[node]) {
+          length++;
+        }
+        lengths[i] = length;
+        maxLength = std::max(maxLength, length);
+      }
+    }
+    if (maxLength <= kMaxCodeLength) {
+      return;
+    }
+    for (auto& count : counts) {
+      count = (count + 1) / 2;
+    }
+  }
+}
+
+// Canonical codes for the lengths, with their bits reversed as the bit
+// stream is written from the lowest bit of each byte. Returns false if the
+// lengths are not those of a prefix code.
+bool buildCodes(const uint8_t* lengths, uint16_t* codes) {
+  uint32_t code = 0;
+  for (int32_t length = 1; length <= kMaxCodeLength; length++) {
+    for (int32_t i = 0; i < 256; i++) {
+      if (lengths[i] == length) {
+        if (code >= (1u << length)) {
+          return false;
+        }
+        uint16_t reversed = 0;
+        for (int32_t j = 0; j < length; j++) {
+          reversed |= ((code >> j) & 1) << (length - 1 - j);
+        }
+        codes[i] = reversed;
+        code++;
+      }
+    }
+    code <<= 1;
+  }
+  return true;
+}
+
+// Codes the symbols data[stride * i], for i < n, from the lowest bit of
+// each byte.
+void encodeStream(
+    const uint8_t* data,
+    size_t n,
+    size_t stride,
+    const uint8_t* lengths,
+    const uint16_t* codes,
+    std::string& out) {
+  uint64_t bits = 0;
+  int32_t nbits = 0;
+  for (size_t i = 0; i < n; i++) {
+    uint8_t symbol = data[stride * i];
+    bits |= uint64_t(codes[symbol]) << nbits;
+    nbits += lengths[symbol];
+    if (nbits >= 32) {
+      uint32_t word = uint32_t(bits);
+      out.append((const char*)&word, sizeof(uint32_t));
+      bits >>= 32;
+      nbits -= 32;
+    }
+  }
+  for (; nbits > 0; nbits -= 8) {
+    out.push_back(char(bits & 0xff));
+    bits >>= 8;
+  }
+}
+
+struct BitReader {
+  const uint8_t* data;
+  const uint8_t* end;
+  uint64_t bits;
+  int32_t nbits;
+};
+
+// Symbol i of the plane, which is out[kPlanes * i], is coded in stream
+// i % kStreams, so that the streams can be decoded together.
+void decodePlane(
+    const uint8_t* data,
+    const uint32_t* sizes,
+    const uint8_t* lengths,
+    uint8_t* out,
+    size_t n) {
+  uint16_t codes[256];
+  for (int32_t i = 0; i < 256; i++) {
+    if (lengths[i] > kMaxCodeLength) {
+      throwInvalidBlock();
+    }
+  }
+  if (!buildCodes(lengths, codes)) {
+    throwInvalidBlock();
+  }
+  // the symbol and the length of the code the next kMaxCodeLength bits
+  // start with, 0 if none does
+  std::vector<uint16_t> table(1 << kMaxCodeLength, 0);
+  for (int32_t i = 0; i < 256; i++) {
+    if (lengths[i] > 0) {
+      for (uint32_t j = codes[i]; j < table.size(); j += 1u << lengths[i]) {
+        table[j] = (i << 4) | lengths[i];
+      }
+    }
+  }
+  const uint32_t mask = (1 << kMaxCodeLength) - 1;
+  BitReader readers[kStreams];
+  for (int32_t k = 0; k < kStreams; k++) {
+    readers[k] = {data, data + sizes[k], 0, 0};
+    data += sizes[k];
+  }
+  auto canRefill = [&]() {
+    for (int32_t k = 0; k < kStreams; k++) {
+      if (readers[k].end - readers[k].data < 8) {
+        return false;
+      }
+    }
+    return true;
+  };
+  size_t i = 0;
+  bool invalid = false;
+  // While 8 bytes are left in each stream, its bits are refilled to at least
+  // 56, which is enough for four codes. The bits past the bytes counted as
+  // read are those of the next bytes, which the next refill ors again in the
+  // same place.
+  for (; i + 4 * kStreams <= n && canRefill(); i += 4 * kStreams) {
+    for (auto& reader : readers) {
+      uint64_t word;
+      std::memcpy(&word, reader.data, sizeof(uint64_t));
+      reader.bits |= word << reader.nbits;
+      int32_t bytes = (63 - reader.nbits) >> 3;
+      reader.data += bytes;
+      reader.nbits += bytes << 3;
+    }
+    for (size_t j = i; j < i + 4 * kStreams; j += kStreams) {
+      for (int32_t k = 0; k < kStreams; k++) {
+        BitReader& reader = readers[k];
+        uint16_t entry = table[reader.bits & mask];
+        int32_t length = entry & 0xf;
+        invalid |= length == 0;
+        out[kPlanes * (j + k)] = uint8_t(entry >> 4);
+        reader.bits >>= length;
+        reader.nbits -= length;
+      }
+    }
+  }
+  if (invalid) {
+    throwInvalidBlock();
+  }
+  for (; i < n; i++) {
+    BitReader& reader = readers[i % kStreams];
+    while (reader.nbits <= 56 && reader.data < reader.end) {
+      reader.bits |= uint64_t(*reader.data++) << reader.nbits;
+      reader.nbits += 8;
+    }
+    uint16_t entry = table[reader.bits & mask];
+    int32_t length = entry & 0xf;
+    if (length == 0 || length > reader.nbits) {
+      throwInvalidBlock();
+    }
+    out[kPlanes * i] = uint8_t(entry >> 4);
+    reader.bits >>= length;
+    reader.nbits -= length;
+  }
+}
+
+void compressBlock(const char* data, size_t size, std::string& out) {
+  const uint8_t* bytes = (const uint8_t*)data;
+  const size_t n = size / kPlanes;
+  std::string planes(1, char(kPlanesBlock));
+  for (int32_t p = 0; p < kPlanes; p++) {
+    std::vector<uint64_t> counts(256, 0);
+    for (size_t i = 0; i < n; i++) {
+      counts[bytes[kPlanes * i + p]]++;
+    }
+    uint8_t lengths[256] = {0};
+    uint64_t codedBits = 0;
+    if (n > 0) {
+      buildCodeLengths(counts, lengths);
+      for (int32_t i = 0; i < 256; i++) {
+        codedBits += counts[i] * lengths[i];
+      }
+    }
+    // planes that would not shrink by a sixteenth are not worth decoding
+    if (n > 0 && codedBits / 8 + kMaxPlaneOverhead < n - n / 16) {
+      uint16_t codes[256];
+      buildCodes(lengths, codes);
+      planes.push_back(char(kHuffmanPlane));
+      planes.append((const char*)lengths, sizeof(lengths));
+      const size_t sizesOffset = planes.size();
+      planes.append(kStreams * sizeof(uint32_t), 0);
+      for (int32_t k = 0; k < kStreams; k++) {
+        const size_t begin = planes.size();
+        if (size_t(k) < n) {
+          encodeStream(
+              bytes + kPlanes * k + p,
+              (n - k + kStreams - 1) / kStreams,
+              kPlanes * kStreams,
+              lengths,
+              codes,
+              planes);
+        }
+        uint32_t size = planes.size() - begin;
+        std::memcpy(
+            &planes[sizesOffset + k * sizeof(uint32_t)],
+            &size,
+            sizeof(uint32_t));
+      }
+    } else {
+      planes.push_back(char(kStoredPlane));
+      for (size_t i = 0; i < n; i++) {
+        planes.push_back(char(bytes[kPlanes * i + p]));
+      }
+    }
+  }
+  planes.append(data + kPlanes * n, size - kPlanes * n);
+  if (planes.size() < size + 1) {
+    out += planes;
+  } else {
+    out.push_back(char(kStoredBlock));
+    out.append(data, size);
+  }
+}
+
+void decompressBlock(
+    const char* data,
+    size_t size,
+    char* out,
+    size_t rawSize) {
+  const uint8_t* bytes = (const uint8_t*)data;
+  const uint8_t* end = bytes + size;
+  if (size == 0) {
+    throwInvalidBlock();
+  }
+  if (*bytes == kStoredBlock) {
+    if (size != rawSize + 1) {
+      throwInvalidBlock();
+    }
+    std::memcpy(out, data + 1, rawSize);
+    return;
+  }
+  if (*bytes++ != kPlanesBlock) {
+    throwInvalidBlock();
+  }
+  const size_t n = rawSize / kPlanes;
+  for (int32_t p = 0; p < kPlanes; p++) {
+    if (bytes == end) {
+      throwInvalidBlock();
+    }
+    uint8_t method = *bytes++;
+    if (method == kStoredPlane) {
+      if (size_t(end - bytes) < n) {
+        throwInvalidBlock();
+      }
+      for (size_t i = 0; i < n; i++) {
+        out[kPlanes * i + p] = char(bytes[i]);
+      }
+      bytes += n;
+    } else if (method == kHuffmanPlane) {
+      const uint8_t* lengths = bytes;
+      uint32_t sizes[kStreams];
+      if (size_t(end - bytes) < kMaxPlaneOverhead - 1) {
+        throwInvalidBlock();
+      }
+      std::memcpy(sizes, bytes + 256, sizeof(sizes));
+      bytes += 256 + sizeof(sizes);
+      size_t codedSize = 0;
+      for (int32_t k = 0; k < kStreams; k++) {
+        codedSize += sizes[k];
+      }
+      if (size_t(end - bytes) < codedSize) {
+        throwInvalidBlock();
+      }
+      decodePlane(bytes, sizes, lengths, (uint8_t*)out + p, n);
+      bytes += codedSize;
+    } else {
+      throwInvalidBlock();
+    }
+  }
+  if (size_t(end - bytes) != rawSize - kPlanes * n) {
+    throwInvalidBlock();
+  }
+  std::memcpy(out + kPlanes * n, bytes, rawSize - kPlanes * n);
+}
+
+CompressedOutputBuffer::CompressedOutputBuffer(
+    std::ostream& out,
+    int32_t thread)
+    : out_(out),
+      thread_(std::max(1, thread)),
+      buffer_(thread_ * kCompressedBlockSize) {
+  setp(buffer_.data(), buffer_.data() + buffer_.size());
+}
+
+int CompressedOutputBuffer::overflow(int c) {
+  writeBlocks();
+  if (c != traits_type::eof()) {
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+  }
+  return traits_type::not_eof(c);
+}
+
+void CompressedOutputBuffer::writeBlocks() {
+  const int64_t size = pptr() - pbase();
+  const int64_t count =
+      (size + kCompressedBlockSize - 1) / kCompressedBlockSize;
+  std::vector<std::string> blocks(count);
+  utils::parallelFor(count, thread_, [&](int64_t begin, int64_t end) {
+    for (int64_t i = begin; i < end; i++) {
+      const int64_t offset = i * kCompressedBlockSize;
+      compressBlock(
+          buffer_.data() + offset,
+          std::min(kCompressedBlockSize, size - offset),
+          blocks[i]);
+    }
+  });
+  for (int64_t i = 0; i < count; i++) {
+    const int64_t offset = i * kCompressedBlockSize;
+    uint32_t header[2] = {
+        uint32_t(std::min(kCompressedBlockSize, size - offset)),
+        uint32_t(blocks[i].size())};
+    out_.write((char*)header, sizeof(header));
+    out_.write(blocks[i].data(), blocks[i].size());
+  }
+  setp(buffer_.data(), buffer_.data() + buffer_.size());
+}
+
+void CompressedOutputBuffer::close() {
+  writeBlocks();
+  uint32_t header[2] = {0, 0};
+  out_.write((char*)header, sizeof(header));
+}
+
+CompressedInputBuffer::CompressedInputBuffer(std::istream& in, int32_t thread)
+    : in_(in),
+      thread_(std::max(1, thread)),
+      buffer_(kCompressedBlockSize),
+      blocks_(thread_),
+      rawSizes_(thread_),
+      pending_(false),
+      pendingRawSize_(0),
+      pendingSize_(0),
+      end_(false) {
+  setg(buffer_.data(), buffer_.data(), buffer_.data());
+}
+
+// Returns false at the end of the data.
+bool CompressedInputBuffer::readHeader(uint32_t& rawSize, uint32_t& size) {
+  if (pending_) {
+    pending_ = false;
+    rawSize = pendingRawSize_;
+    size = pendingSize_;
+    return true;
+  }
+  if (end_) {
+    return false;
+  }
+  uint32_t header[2];
+  if (!in_.read((char*)header, sizeof(header))) {
+    throw std::invalid_argument("Compressed data is truncated!");
+  }
+  rawSize = header[0];
+  size = header[1];
+  if (rawSize == 0) {
+    end_ = true;
+    return false;
+  }
+  if (rawSize > kCompressedBlockSize ||
+      size > kCompressedBlockSize + kMaxBlockOverhead) {
+    throwInvalidBlock();
+  }
+  return true;
+}
+
+int CompressedInputBuffer::underflow() {
+  if (gptr() < egptr()) {
+    return traits_type::to_int_type(*gptr());
+  }
+  uint32_t rawSize, size;
+  if (!readHeader(rawSize, size)) {
+    return traits_type::eof();
+  }
+  std::vector<char>& data = blocks_[0];
+  data.resize(size);
+  if (!in_.read(data.data(), size)) {
+    throw std::invalid_argument("Compressed data is truncated!");
+  }
+  decompressBlock(data.data(), size, buffer_.data(), rawSize);
+  setg(buffer_.data(), buffer_.data(), buffer_.data() + rawSize);
+  return traits_type::to_int_type(*gptr());
+}
+
+std::streamsize CompressedInputBuffer::xsgetn(char* s, std::streamsize n) {
+  // most reads are small, such as the entries of a dictionary
+  if (n <= egptr() - gptr()) {
+    std::memcpy(s, gptr(), n);
+    gbump(n);
+    return n;
+  }
+  std::streamsize copied = 0;
+  while (copied < n) {
+    if (gptr() < egptr()) {
+      std::streamsize size =
+          std::min<std::streamsize>(n - copied, egptr() - gptr());
+      std::memcpy(s + copied, gptr(), size);
+      gbump(size);
+      copied += size;
+      continue;
+    }
+    // the next blocks that fit whole are decompressed in place
+    int32_t count = 0;
+    std::streamsize batch = 0;
+    uint32_t rawSize, size;
+    while (count < thread_ && readHeader(rawSize, size)) {
+      if (rawSize > n - copied - batch) {
+        pending_ = true;
+        pendingRawSize_ = rawSize;
+        pendingSize_ = size;
+        break;
+      }
+      blocks_[count].resize(size);
+      if (!in_.read(blocks_[count].data(), size)) {
+        throw std::invalid_argument("Compressed data is truncated!");
+      }
+      rawSizes_[count++] = rawSize;
+      batch += rawSize;
+    }
+    if (count == 0) {
+      if (underflow() == traits_type::eof()) {
+        break;
+      }
+      continue;
+    }
+    std::vector<std::streamsize> offsets(count, copied);
+    for (int32_t i = 1; i < count; i++) {
+      offsets[i] = offsets[i - 1] + rawSizes_[i - 1];
+    }
+    utils::parallelFor(count, thread_, [&](int64_t begin, int64_t end) {
+      for (int64_t i = begin; i < end; i++) {
+        decompressBlock(
+            blocks_[i].data(),
+            blocks_[i].size(),
+            s + offsets[i],
+            rawSizes_[i]);
+      }
+    });
+    copied += batch;
+  }
+  return copied;
+}
+
+void CompressedInputBuffer::skipToEnd() {
+  setg(buffer_.data(), buffer_.data(), buffer_.data());
+  uint32_t rawSize, size;
+  while (readHeader(rawSize, size)) {
+    in_.ignore(size);
+  }
+}
+
+} // namespace fasttext
@@ -0,0 +1,86 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace fasttext {
+
+/**
+ * Compressed data is a sequence of blocks of at most kCompressedBlockSize
+ * bytes, each stored as its size, the size of its compressed bytes (both
+ * uint32) and these bytes, and ended by a block of size 0. A block is
+ * compressed with a codec that needs no library: as most of a model is made
+ * of 4 byte floats and ints, its bytes are split in four planes by their
+ * position modulo 4, and each plane is kept as is or coded with a Huffman
+ * code of its own, which mostly shrinks the plane of the sign and exponent.
+ */
+const int64_t kCompressedBlockSize = 1 << 20;
+
+// Appends the compressed bytes of a block to out.
+void compressBlock(const char* data, size_t size, std::string& out);
+
+// Decompresses the size bytes of a block into the rawSize bytes of out.
+void decompressBlock(
+    const char* data,
+    size_t size,
+    char* out,
+    size_t rawSize);
+
+// Compresses what is written to it into out, thread blocks at a time. close
+// writes the last blocks and the end of the data.
+class CompressedOutputBuffer : public std::streambuf {
+ protected:
+  std::ostream& out_;
+  int32_t thread_;
+  std::vector<char> buffer_;
+
+  int overflow(int c) override;
+  void writeBlocks();
+
+ public:
+  CompressedOutputBuffer(std::ostream& out, int32_t thread);
+
+  void close();
+};
+
+// Reads and decompresses the blocks of in. Large reads get as many whole
+// blocks as they can decompressed straight into their destination, thread
+// blocks at a time.
+class CompressedInputBuffer : public std::streambuf {
+ protected:
+  std::istream& in_;
+  int32_t thread_;
+  std::vector<char> buffer_;
+  // the compressed bytes and sizes of the blocks decompressed together
+  std::vector<std::vector<char>> blocks_;
+  std::vector<uint32_t> rawSizes_;
+  // a block whose header was read but which did not fit in a read
+  bool pending_;
+  uint32_t pendingRawSize_;
+  uint32_t pendingSize_;
+  bool end_;
+
+  bool readHeader(uint32_t& rawSize, uint32_t& size);
+  int underflow() override;
+  std::streamsize xsgetn(char* s, std::streamsize n) override;
+
+ public:
+  CompressedInputBuffer(std::istream& in, int32_t thread);
+
+  // Reads the blocks that are left, up to the end of the data.
+  void skipToEnd();
+};
+
+} // namespace fasttext
@@ -0,0 +1,289 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "corpus.h"
+
+#include <iostream>
+#include <stdexcept>
+
+#include "utils.h"
+
+namespace fasttext {
+
+constexpr int32_t CORPUS_VERSION = 1;
+constexpr int32_t CORPUS_FILEFORMAT_MAGIC_INT32 = 793712315;
+
+Corpus::Corpus(const std::string& filename, std::shared_ptr<Args> args)
+    : filename_(filename),
+      inMemory_(false),
+      dict_(),
+      nrecords_(0),
+      dataOffset_(0),
+      maxRecordSize_(0),
+      index_(),
+      data_() {
+  std::ifstream ifs(filename, std::ifstream::binary);
+  if (!ifs.is_open()) {
+    throw std::invalid_argument(filename + " cannot be opened for loading!");
+  }
+  int32_t magic;
+  int32_t version;
+  ifs.read((char*)&magic, sizeof(int32_t));
+  ifs.read((char*)&version, sizeof(int32_t));
+  if (magic != CORPUS_FILEFORMAT_MAGIC_INT32 || version > CORPUS_VERSION) {
+    throw std::invalid_argument(filename + " has wrong file format!");
+  }
+  checkArgs(ifs, *args);
+  dict_ = std::make_shared<Dictionary>(args, ifs);
+
+  int64_t indexOffset;
+  ifs.read((char*)&nrecords_, sizeof(int64_t));
+  ifs.read((char*)&indexOffset, sizeof(int64_t));
+  dataOffset_ = ifs.tellg();
+  // a record holds at least its size and its number of tokens
+  const int64_t minRecordBytes = 2 * sizeof(int32_t);
+  if (!ifs || nrecords_ <= 0 || indexOffset < dataOffset_ ||
+      nrecords_ > (indexOffset - dataOffset_) / minRecordBytes) {
+    throw std::invalid_argument(filename + " is truncated or empty!");
+  }
+  if (args->model == model_name::sup) {
+    maxRecordSize_ = (indexOffset - dataOffset_) / sizeof(int32_t) - 1;
+  } else {
+    // the number of tokens followed by at most MAX_LINE_SIZE + 1 ids
+    maxRecordSize_ = Dictionary::MAX_LINE_SIZE + 2;
+  }
+  index_.resize((nrecords_ + kIndexStride - 1) / kIndexStride);
+  ifs.seekg(indexOffset);
+  ifs.read((char*)index_.data(), index_.size() * sizeof(int64_t));
+  if (!ifs) {
+    throw std::invalid_argument(filename + " is truncated or empty!");
+  }
+}
+
+// Keeps one record out of every stride lines that are not empty.
+Corpus::Corpus(
+    std::shared_ptr<Dictionary> dict,
+    std::istream& in,
+    int64_t stride)
+    : filename_(),
+      inMemory_(true),
+      dict_(dict),
+      nrecords_(0),
+      dataOffset_(0),
+      maxRecordSize_(0),
+      index_(),
+      data_() {
+  std::vector<int32_t> record;
+  int64_t nlines = 0;
+  while (in.peek() != EOF) {
+    if (dict_->encodeLine(in, record) == 0 || nlines++ % stride != 0) {
+      continue;
+    }
+    if (nrecords_ % kIndexStride == 0) {
+      index_.push_back(data_.size());
+    }
+    data_.push_back(record.size());
+    data_.insert(data_.end(), record.cbegin(), record.cend());
+    nrecords_++;
+  }
+  data_.shrink_to_fit();
+}
+
+bool Corpus::isCorpus(const std::string& filename) {
+  std::ifstream ifs(filename, std::ifstream::binary);
+  int32_t magic = 0;
+  ifs.read((char*)&magic, sizeof(int32_t));
+  return ifs && magic == CORPUS_FILEFORMAT_MAGIC_INT32;
+}
+
+// Only the arguments that change which ids a token is encoded to are stored;
+// the others (wordNgrams, t, ...) are applied when the records are read back.
+void Corpus::saveArgs(std::ostream& out, const Args& args) {
+  int32_t labelSize = args.label.size();
+  out.write((char*)&(args.model), sizeof(model_name));
+  out.write((char*)&(args.minCount), sizeof(int));
+  out.write((char*)&(args.minCountLabel), sizeof(int));
+  out.write((char*)&(args.bucket), sizeof(int));
+  out.write((char*)&(args.minn), sizeof(int));
+  out.write((char*)&(args.maxn), sizeof(int));
+  out.write((char*)&labelSize, sizeof(int32_t));
+  out.write(args.label.data(), labelSize);
+}
+
+void Corpus::checkArgs(std::istream& in, const Args& args) {
+  Args saved;
+  int32_t labelSize;
+  in.read((char*)&(saved.model), sizeof(model_name));
+  in.read((char*)&(saved.minCount), sizeof(int));
+  in.read((char*)&(saved.minCountLabel), sizeof(int));
+  in.read((char*)&(saved.bucket), sizeof(int));
+  in.read((char*)&(saved.minn), sizeof(int));
+  in.read((char*)&(saved.maxn), sizeof(int));
+  in.read((char*)&labelSize, sizeof(int32_t));
+  saved.label.resize(labelSize);
+  in.read(&saved.label[0], labelSize);
+
+  auto mismatch = [](const std::string& name, const std::string& value) {
+    throw std::invalid_argument(
+        "Preprocessed corpus was built with -" + name + " " + value +
+        ", which does not match the training arguments!");
+  };
+  if ((saved.model == model_name::sup) != (args.model == model_name::sup)) {
+    mismatch(
+        "model",
+        saved.model == model_name::sup ? "supervised" : "cbow/skipgram");
+  }
+  if (saved.minCount != args.minCount) {
+    mismatch("minCount", std::to_string(saved.minCount));
+  }
+  if (saved.minCountLabel != args.minCountLabel) {
+    mismatch("minCountLabel", std::to_string(saved.minCountLabel));
+  }
+  if (saved.label != args.label) {
+    mismatch("label", saved.label);
+  }
+  if (saved.minn != args.minn) {
+    mismatch("minn", std::to_string(saved.minn));
+  }
+  if (saved.maxn != args.maxn) {
+    mismatch("maxn", std::to_string(saved.maxn));
+  }
+  // buckets only matter for the subwords of out of vocabulary words
+  if (saved.maxn > 0 && saved.bucket != args.bucket) {
+    mismatch("bucket", std::to_string(saved.bucket));
+  }
+}
+
+void Corpus::preprocess(
+    std::shared_ptr<Args> args,
+    const std::string& output) {
+  std::ifstream ifs(args->input);
+  if (!ifs.is_open()) {
+    throw std::invalid_argument(
+        args->input + " cannot be opened for preprocessing!");
+  }
+  Dictionary dict(args);
+  dict.readFromFile(ifs);
+
+  std::ofstream ofs(output, std::ofstream::binary);
+  if (!ofs.is_open()) {
+    throw std::invalid_argument(output + " cannot be opened for saving!");
+  }
+  const int32_t magic = CORPUS_FILEFORMAT_MAGIC_INT32;
+  const int32_t version = CORPUS_VERSION;
+  ofs.write((char*)&magic, sizeof(int32_t));
+  ofs.write((char*)&version, sizeof(int32_t));
+  saveArgs(ofs, *args);
+  dict.save(ofs);
+
+  int64_t nrecords = 0;
+  int64_t indexOffset = 0;
+  std::streampos countsPosition = ofs.tellp();
+  ofs.write((char*)&nrecords, sizeof(int64_t));
+  ofs.write((char*)&indexOffset, sizeof(int64_t));
+
+  std::vector<int64_t> index;
+  std::vector<int32_t> record;
+  utils::seek(ifs, 0);
+  while (ifs.peek() != EOF) {
+    if (dict.encodeLine(ifs, record) == 0) {
+      continue;
+    }
+    if (nrecords % kIndexStride == 0) {
+      index.push_back(ofs.tellp());
+    }
+    int32_t size = record.size();
+    ofs.write((char*)&size, sizeof(int32_t));
+    ofs.write((char*)record.data(), size * sizeof(int32_t));
+    nrecords++;
+  }
+  indexOffset = ofs.tellp();
+  ofs.write((char*)index.data(), index.size() * sizeof(int64_t));
+  ofs.seekp(countsPosition);
+  ofs.write((char*)&nrecords, sizeof(int64_t));
+  ofs.write((char*)&indexOffset, sizeof(int64_t));
+  ofs.close();
+  if (args->verbose > 0) {
+    std::cerr << "Number of lines:  " << nrecords << std::endl;
+  }
+}
+
+std::shared_ptr<Dictionary> Corpus::getDictionary() const {
+  return dict_;
+}
+
+int64_t Corpus::nrecords() const {
+  return nrecords_;
+}
+
+Corpus::Reader::Reader(const Corpus& corpus, int64_t firstRecord)
+    : corpus_(corpus),
+      ifs_(),
+      streamBuffer_(1 << 20),
+      record_(),
+      position_(0),
+      offset_(0) {
+  if (corpus_.nrecords_ == 0) {
+    throw std::invalid_argument("Corpus has no records to read!");
+  }
+  if (corpus_.inMemory_) {
+    seek(firstRecord);
+    return;
+  }
+  ifs_.rdbuf()->pubsetbuf(streamBuffer_.data(), streamBuffer_.size());
+  ifs_.open(corpus_.filename_, std::ifstream::binary);
+  if (!ifs_.is_open()) {
+    throw std::invalid_argument(
+        corpus_.filename_ + " cannot be opened for training!");
+  }
+  seek(firstRecord);
+}
+
+void Corpus::Reader::seek(int64_t record) {
+  int64_t block = record / kIndexStride;
+  if (corpus_.inMemory_) {
+    offset_ = corpus_.index_[block];
+  } else {
+    utils::seek(ifs_, corpus_.index_[block]);
+  }
+  position_ = block * kIndexStride;
+  while (position_ < record) {
+    next();
+  }
+}
+
+const int32_t* Corpus::Reader::next() {
+  if (corpus_.inMemory_) {
+    if (position_ == corpus_.nrecords_) {
+      position_ = 0;
+      offset_ = 0;
+    }
+    position_++;
+    const int32_t* record = corpus_.data_.data() + offset_;
+    offset_ += *record + 1;
+    return record + 1;
+  }
+  if (position_ == corpus_.nrecords_) {
+    utils::seek(ifs_, corpus_.dataOffset_);
+    position_ = 0;
+  }
+  position_++;
+  int32_t size = 0;
+  ifs_.read((char*)&size, sizeof(int32_t));
+  if (!ifs_ || size <= 0 || size > corpus_.maxRecordSize_) {
+    throw std::invalid_argument(corpus_.filename_ + " is corrupted!");
+  }
+  record_.resize(size);
+  ifs_.read((char*)record_.data(), size * sizeof(int32_t));
+  if (!ifs_) {
+    throw std::invalid_argument(corpus_.filename_ + " is truncated!");
+  }
+  return record_.data();
+}
+
+} // namespace fasttext
@@ -0,0 +1,85 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "args.h"
+#include "dictionary.h"
+
+namespace fasttext {
+
+/**
+ * A training file that has already been tokenized against its dictionary.
+ *
+ * The file starts with a header, the arguments the dictionary was built with
+ * and the dictionary itself, followed by one record of int32 values per call
+ * to Dictionary::getLine (see Dictionary::encodeLine) and by an index giving
+ * the byte offset of every kIndexStride-th record, so that each training
+ * thread can start reading at its own share of the corpus.
+ *
+ * A corpus can also be tokenized into memory (e.g. to be reused by several
+ * autotune trials), in which case the records are kept in the same layout
+ * and the index holds offsets into that buffer.
+ */
+class Corpus {
+ protected:
+  static const int32_t kIndexStride = 1024;
+
+  std::string filename_;
+  bool inMemory_;
+  std::shared_ptr<Dictionary> dict_;
+  int64_t nrecords_;
+  int64_t dataOffset_;
+  // bound on the size of a record, checked as records are read from the file
+  int64_t maxRecordSize_;
+  std::vector<int64_t> index_;
+  std::vector<int32_t> data_;
+
+  static void saveArgs(std::ostream&, const Args&);
+  static void checkArgs(std::istream&, const Args&);
+
+ public:
+  Corpus(const std::string& filename, std::shared_ptr<Args> args);
+  Corpus(
+      std::shared_ptr<Dictionary> dict,
+      std::istream& in,
+      int64_t stride = 1);
+
+  static bool isCorpus(const std::string& filename);
+  static void preprocess(std::shared_ptr<Args> args, const std::string& output);
+
+  std::shared_ptr<Dictionary> getDictionary() const;
+  int64_t nrecords() const;
+
+  class Reader {
+   protected:
+    const Corpus& corpus_;
+    std::ifstream ifs_;
+    std::vector<char> streamBuffer_;
+    std::vector<int32_t> record_;
+    int64_t position_;
+    int64_t offset_;
+
+    void seek(int64_t record);
+
+   public:
+    // Reading cycles through the records, so the corpus must have some.
+    Reader(const Corpus& corpus, int64_t firstRecord);
+    const int32_t* next();
+  };
+};
+
+} // namespace fasttext
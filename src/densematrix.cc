@@ -8,17 +8,15 @@
 
 #include "densematrix.h"
 
+#include <algorithm>
 #include <random>
 #include <stdexcept>
 #include <thread>
 #include <utility>
+#include "simd.h"
 #include "utils.h"
 #include "vector.h"
 
-#if defined(__AVX512F__) || defined(__AVX__) || defined(__SSE__)
-#include <immintrin.h>
-#endif
-
 namespace fasttext {
 
 DenseMatrix::DenseMatrix() : DenseMatrix(0, 0) {}
@@ -59,6 +57,10 @@ void DenseMatrix::uniform(real a, unsigned int thread, int32_t seed) {
     // webassembly can't instantiate `std::thread`
     uniformThread(a, 0, seed);
   }
+  // Only the first min(thread, 10) blocks are drawn; the rest of the matrix
+  // stays zero as the storage is not initialized on allocation.
+  int64_t blocks = std::min(std::max(thread, 1u), 10u);
+  std::fill(data_.begin() + blocks * ((m_ * n_) / 10), data_.end(), 0.0);
 }
 
 void DenseMatrix::multiplyRow(const Vector& nums, int64_t ib, int64_t ie) {
@@ -91,6 +93,21 @@ void DenseMatrix::divideRow(const Vector& denoms, int64_t ib, int64_t ie) {
   }
 }
 
+void DenseMatrix::compactRows(const std::vector<int32_t>& rows) {
+  const int64_t k = rows.size();
+  assert(k <= m_);
+  // Row i comes from a row that is not before it, and that no earlier row
+  // has been moved to, so the rows are moved forward in one pass.
+  for (int64_t i = 0; i < k; i++) {
+    assert(rows[i] < m_ && (i == 0 ? rows[i] >= 0 : rows[i] > rows[i - 1]));
+    if (rows[i] != i) {
+      const real* row = data_.data() + rows[i] * n_;
+      std::copy(row, row + n_, data_.data() + i * n_);
+    }
+  }
+  m_ = k;
+}
+
 real DenseMatrix::l2NormRow(int64_t i) const {
   auto norm = 0.0;
   for (auto j = 0; j < n_; j++) {
@@ -102,10 +119,38 @@ real DenseMatrix::l2NormRow(int64_t i) const {
   return std::sqrt(norm);
 }
 
-void DenseMatrix::l2NormRow(Vector& norms) const {
+void DenseMatrix::l2NormRow(Vector& norms, unsigned int thread) const {
   assert(norms.size() == m_);
+  auto normRows = [&](int64_t begin, int64_t end) {
+    for (auto i = begin; i < end; i++) {
+      const real* row = data_.data() + i * n_;
+      auto norm = 0.0;
+      for (auto j = 0; j < n_; j++) {
+        norm += row[j] * row[j];
+      }
+      norms[i] = std::sqrt(norm);
+    }
+  };
+  if (thread > 1 && m_ > thread) {
+    std::vector<std::thread> threads;
+    for (int64_t t = 0; t < thread; t++) {
+      int64_t begin = m_ * t / thread;
+      int64_t end = m_ * (t + 1) / thread;
+      threads.push_back(std::thread([=]() { normRows(begin, end); }));
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+  } else {
+    // webassembly can't instantiate `std::thread`
+    normRows(0, m_);
+  }
+  // NaNs propagate to the norm, so the rows only need to be checked once
+  // they are all computed.
   for (auto i = 0; i < m_; i++) {
-    norms[i] = l2NormRow(i);
+    if (std::isnan(norms[i])) {
+      throw EncounteredNaNError();
+    }
   }
 }
 
@@ -127,8 +172,17 @@ void DenseMatrix::addVectorToRow(const Vector& vec, int64_t i, real a) {
   assert(i >= 0);
   assert(i < m_);
   assert(vec.size() == n_);
-  for (int64_t j = 0; j < n_; j++) {
-    data_[i * n_ + j] += a * vec[j];
+  real* row = data_.data() + i * n_;
+  int64_t j = 0;
+#if defined(__AVX512F__) || defined(__AVX__) || defined(__SSE__)
+  constexpr int64_t kWidth = sizeof(Register) / sizeof(real);
+  const Register scale = Set1(a);
+  for (; j + kWidth <= n_; j += kWidth) {
+    StoreU(row + j, Add(LoadU(row + j), Multiply(scale, LoadU(vec.data() + j))));
+  }
+#endif
+  for (; j < n_; j++) {
+    row[j] += a * vec[j];
   }
 }
 
@@ -150,28 +204,10 @@ void DenseMatrix::addRowToVector(Vector& x, int32_t i, real a) const {
   }
 }
 
-/* Abstract over AVX512F, AVX, and SSE intrinsics, using the one available on this machine. */
-#if defined(__AVX512F__)
-using Register = __m512;
-inline Register Add(Register first, Register second) { return _mm512_add_ps(first, second); }
-inline Register Set1(float to) { return _mm512_set1_ps(to); }
-inline Register Multiply(Register first, Register second) { return _mm512_mul_ps(first, second); }
-#elif defined(__AVX__)
-using Register = __m256;
-inline Register Add(Register first, Register second) { return _mm256_add_ps(first, second); }
-inline Register Set1(float to) { return _mm256_set1_ps(to); }
-inline Register Multiply(Register first, Register second) { return _mm256_mul_ps(first, second); }
-#elif defined(__SSE__)
-using Register = __m128;
-inline Register Add(Register first, Register second) { return _mm_add_ps(first, second); }
-inline Register Set1(float to) { return _mm_set1_ps(to); }
-inline Register Multiply(Register first, Register second) { return _mm_mul_ps(first, second); }
-#endif
-
 /* Faster routine for averaging rows of a matrix on x86.
  * The idea here is to keep the accumulators in registers if possible. */
 #if defined(__AVX512F__) || defined(__AVX__) || defined(__SSE__)
-template <unsigned Cols> void averageRowsFast(Vector& x, const std::vector<int32_t>& rows, const DenseMatrix &matrix) {
+template <unsigned Cols> void averageRowsFast(Vector& x, Span<const int32_t> rows, const DenseMatrix &matrix) {
   // Columns must be a multiple of how many floats fit in a register.
   static_assert(Cols % (sizeof(Register) / 4) == 0);
   constexpr unsigned RegisterCount = Cols / (sizeof(Register) / 4);
@@ -188,13 +224,13 @@ template <unsigned Cols> void averageRowsFast(Vector& x, const std::vector<int32
 
   // Copy the first row to accumulation registers.
   Register accum[RegisterCount];
-  auto row = rows.cbegin();
+  auto row = rows.begin();
   const Register *base = reinterpret_cast<const Register*>(matrix.data() + matrix.cols() * *row);
   for (unsigned i = 0; i < RegisterCount; ++i) {
     accum[i] = base[i];
   }
   // Add the rows after the first.
-  for (++row; row != rows.cend(); ++row) {
+  for (++row; row != rows.end(); ++row) {
     base = reinterpret_cast<const Register*>(matrix.data() + matrix.cols() * *row);
     for (unsigned i = 0; i < RegisterCount; ++i) {
       accum[i] = Add(accum[i], base[i]);
@@ -208,7 +244,7 @@ template <unsigned Cols> void averageRowsFast(Vector& x, const std::vector<int32
 }
 #endif
 
-void DenseMatrix::averageRowsToVector(Vector& x, const std::vector<int32_t>& rows) const {
+void DenseMatrix::averageRowsToVector(Vector& x, Span<const int32_t> rows) const {
 #if defined(__AVX512F__) || defined(__AVX__) || defined(__SSE__)
   switch (cols()) {
     case 512:
@@ -230,7 +266,7 @@ void DenseMatrix::averageRowsToVector(Vector& x, const std::vector<int32_t>& row
   }
 #endif
   x.zero();
-  for (auto it = rows.cbegin(); it != rows.cend(); ++it) {
+  for (auto it = rows.begin(); it != rows.end(); ++it) {
     addRowToVector(x, *it);
   }
   x.mul(1.0 / rows.size());
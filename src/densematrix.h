@@ -65,14 +65,19 @@ class DenseMatrix : public Matrix {
   void multiplyRow(const Vector& nums, int64_t ib = 0, int64_t ie = -1);
   void divideRow(const Vector& denoms, int64_t ib = 0, int64_t ie = -1);
 
+  // Keeps rows[0], rows[1], ... as the rows of the matrix, for increasing
+  // rows, moving them in place. The memory of the other rows stays allocated
+  // until the matrix is released.
+  void compactRows(const std::vector<int32_t>& rows);
+
   real l2NormRow(int64_t i) const;
-  void l2NormRow(Vector& norms) const;
+  void l2NormRow(Vector& norms, unsigned int thread = 1) const;
 
   real dotRow(const Vector&, int64_t) const override;
   void addVectorToRow(const Vector&, int64_t, real) override;
   void addRowToVector(Vector& x, int32_t i) const override;
   void addRowToVector(Vector& x, int32_t i, real a) const override;
-  void averageRowsToVector(Vector& x, const std::vector<int32_t>& rows) const override;
+  void averageRowsToVector(Vector& x, Span<const int32_t> rows) const override;
   void save(std::ostream&) const override;
   void load(std::istream&) override;
   void dump(std::ostream&) const override;
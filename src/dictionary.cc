@@ -15,8 +15,16 @@
 #include <fstream>
 #include <iostream>
 #include <iterator>
+#include <limits>
 #include <stdexcept>
 
+#if defined(__GNUC__) && (defined(__AVX2__) || defined(__SSE2__))
+#include <immintrin.h>
+#endif
+
+#include "sketch.h"
+#include "utils.h"
+
 namespace fasttext {
 
 const std::string Dictionary::EOS = "</s>";
@@ -32,14 +40,36 @@ Dictionary::Dictionary(std::shared_ptr<Args> args)
       ntokens_(0),
       pruneidx_size_(-1) {}
 
-Dictionary::Dictionary(std::shared_ptr<Args> args, std::istream& in)
+Dictionary::Dictionary(
+    std::shared_ptr<Args> args,
+    std::istream& in,
+    index_source index)
     : args_(args),
       size_(0),
       nwords_(0),
       nlabels_(0),
       ntokens_(0),
       pruneidx_size_(-1) {
-  load(in);
+  loadEntries(in);
+  if (index == index_source::stored) {
+    loadIndex(in);
+  } else if (index == index_source::build) {
+    buildIndex();
+  }
+}
+
+// Reuses the words and counts of another dictionary, recomputing what depends
+// on the arguments (discard table and subwords).
+Dictionary::Dictionary(
+    std::shared_ptr<Args> args,
+    const Dictionary& vocabulary)
+    : Dictionary(vocabulary) {
+  if (pruneidx_size_ >= 0) {
+    throw std::invalid_argument("Cannot reuse a pruned dictionary!");
+  }
+  args_ = args;
+  initTableDiscard();
+  initNgrams(args_->thread);
 }
 
 int32_t Dictionary::find(const std::string_view w) const {
@@ -55,7 +85,7 @@ int32_t Dictionary::find(const std::string_view w, uint32_t h) const {
   return id;
 }
 
-void Dictionary::add(const std::string& w) {
+void Dictionary::add(std::string_view w) {
   int32_t h = find(w);
   ntokens_++;
   if (word2int_[h] == -1) {
@@ -70,6 +100,32 @@ void Dictionary::add(const std::string& w) {
   }
 }
 
+// Counts a word in the sketch until its estimated count reaches minCount, and
+// only then adds it, with this estimate as its count: no word that occurs
+// minCount times is missed, and rare words never take memory. Labels are
+// always added.
+void Dictionary::addSketched(std::string_view w, CountMinSketch& sketch) {
+  uint32_t h = hash(w);
+  int32_t id = find(w, h);
+  ntokens_++;
+  if (word2int_[id] != -1) {
+    words_[word2int_[id]].count++;
+    return;
+  }
+  entry e;
+  e.type = getType(w);
+  e.count = 1;
+  if (e.type == entry_type::word) {
+    e.count = sketch.add(h);
+    if (e.count < args_->minCount) {
+      return;
+    }
+  }
+  e.word = w;
+  words_.push_back(e);
+  word2int_[id] = size_++;
+}
+
 int32_t Dictionary::nwords() const {
   return nwords_;
 }
@@ -82,17 +138,20 @@ int64_t Dictionary::ntokens() const {
   return ntokens_;
 }
 
-const std::vector<int32_t>& Dictionary::getSubwords(int32_t i) const {
+Span<const int32_t> Dictionary::getSubwords(int32_t i) const {
   assert(i >= 0);
   assert(i < nwords_);
-  return words_[i].subwords;
+  return Span<const int32_t>(
+      subwords_.data() + subwordOffsets_[i],
+      subwords_.data() + subwordOffsets_[i + 1]);
 }
 
 const std::vector<int32_t> Dictionary::getSubwords(
     const std::string& word) const {
   int32_t i = getId(word);
   if (i >= 0) {
-    return getSubwords(i);
+    Span<const int32_t> ngrams = getSubwords(i);
+    return std::vector<int32_t>(ngrams.begin(), ngrams.end());
   }
   std::vector<int32_t> ngrams;
   if (word != EOS) {
@@ -194,48 +253,221 @@ void Dictionary::computeSubwords(
   }
 }
 
-void Dictionary::initNgrams() {
-  for (size_t i = 0; i < size_; i++) {
-    std::string word = BOW + words_[i].word + EOW;
-    words_[i].subwords.clear();
-    words_[i].subwords.push_back(i);
-    if (words_[i].word != EOS) {
-      computeSubwords(word, words_[i].subwords);
+// Each thread computes the subwords of a range of words into an array of its
+// own, with offsets relative to it, and the arrays are then concatenated.
+void Dictionary::initNgrams(int32_t thread) {
+  thread = std::max(1, thread);
+  // the subwords of each range of words, and the last word of the range
+  std::vector<std::vector<int32_t>> parts(thread);
+  std::vector<int32_t> ends(thread, 0);
+  subwordOffsets_.assign(size_ + 1, 0);
+  int32_t ranges = utils::parallelForThreads(
+      size_, thread, [&](int32_t t, int64_t begin, int64_t end) {
+        std::vector<int32_t>& part = parts[t];
+        for (int32_t i = begin; i < end; i++) {
+          part.push_back(i);
+          if (words_[i].word != EOS) {
+            computeSubwords(BOW + words_[i].word + EOW, part);
+          }
+          subwordOffsets_[i + 1] = part.size();
+        }
+        ends[t] = end;
+      });
+  int64_t size = 0;
+  for (int32_t t = 0; t < ranges; t++) {
+    for (int32_t i = t > 0 ? ends[t - 1] : 0; i < ends[t]; i++) {
+      subwordOffsets_[i + 1] += size;
     }
+    size += parts[t].size();
+  }
+  subwords_.clear();
+  subwords_.reserve(size);
+  for (auto& part : parts) {
+    subwords_.insert(subwords_.end(), part.begin(), part.end());
+    std::vector<int32_t>().swap(part);
   }
 }
 
+namespace {
+
+bool isSeparator(int c) {
+  return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' ||
+      c == '\f' || c == '\0';
+}
+
+// The separators among the kChunk bytes at p, as a bit mask. They are found
+// with a few compares: ' ' and '\0' with equality, and '\t', '\n', '\v', '\f'
+// and '\r', which are 9 to 13, as the bytes c for which c - 9 is at most 4
+// (unsigned).
+#if defined(__GNUC__) && defined(__AVX2__)
+constexpr std::ptrdiff_t kChunk = sizeof(__m256i);
+
+uint32_t separatorMask(const char* p) {
+  __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+  __m256i control = _mm256_sub_epi8(c, _mm256_set1_epi8('\t'));
+  control = _mm256_cmpeq_epi8(
+      _mm256_min_epu8(control, _mm256_set1_epi8(4)), control);
+  __m256i separator = _mm256_or_si256(
+      _mm256_or_si256(
+          _mm256_cmpeq_epi8(c, _mm256_set1_epi8(' ')),
+          _mm256_cmpeq_epi8(c, _mm256_setzero_si256())),
+      control);
+  return _mm256_movemask_epi8(separator);
+}
+#elif defined(__GNUC__) && defined(__SSE2__)
+constexpr std::ptrdiff_t kChunk = sizeof(__m128i);
+
+uint32_t separatorMask(const char* p) {
+  __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+  __m128i control = _mm_sub_epi8(c, _mm_set1_epi8('\t'));
+  control =
+      _mm_cmpeq_epi8(_mm_min_epu8(control, _mm_set1_epi8(4)), control);
+  __m128i separator = _mm_or_si128(
+      _mm_or_si128(
+          _mm_cmpeq_epi8(c, _mm_set1_epi8(' ')),
+          _mm_cmpeq_epi8(c, _mm_setzero_si128())),
+      control);
+  return _mm_movemask_epi8(separator);
+}
+#endif
+
+// The first separator of [begin, end), or end.
+const char* findSeparator(const char* begin, const char* end) {
+#if defined(__GNUC__) && (defined(__AVX2__) || defined(__SSE2__))
+  for (; end - begin >= kChunk; begin += kChunk) {
+    uint32_t mask = separatorMask(begin);
+    if (mask != 0) {
+      return begin + __builtin_ctz(mask);
+    }
+  }
+#endif
+  while (begin < end && !isSeparator(static_cast<unsigned char>(*begin))) {
+    begin++;
+  }
+  return begin;
+}
+
+// The get area of a streambuf, whose accessors are protected: they can still
+// be called on any streambuf through pointers to members named from a derived
+// class.
+struct GetArea : std::streambuf {
+  static char* begin(std::streambuf& sb) {
+    return (sb.*&GetArea::gptr)();
+  }
+  static char* end(std::streambuf& sb) {
+    return (sb.*&GetArea::egptr)();
+  }
+  // gbump takes an int, which a get area may not fit in
+  static void bump(std::streambuf& sb, const char* to) {
+    std::ptrdiff_t n = to - begin(sb);
+    while (n > 0) {
+      int step = std::min<std::ptrdiff_t>(n, std::numeric_limits<int>::max());
+      (sb.*&GetArea::gbump)(step);
+      n -= step;
+    }
+  }
+};
+
+} // namespace
+
 bool Dictionary::readWord(std::istream& in, std::string& word) const {
-  int c;
+  std::string_view view;
+  bool found = readWord(in, view, word);
+  if (view.data() != word.data()) {
+    word.assign(view.data(), view.size());
+  }
+  return found;
+}
+
+// Scans the get area of the stream buffer directly, so that words are found
+// many bytes at a time and, unless they straddle two fillings of the buffer,
+// are views of it rather than copies. The stream is left where the character
+// by character version would leave it: after the separator ending a word, or
+// on it if it is a newline, which then gives the EOS of the next call.
+bool Dictionary::readWord(
+    std::istream& in,
+    std::string_view& word,
+    std::string& storage) const {
   std::streambuf& sb = *in.rdbuf();
-  word.clear();
-  while ((c = sb.sbumpc()) != EOF) {
-    if (c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' ||
-        c == '\f' || c == '\0') {
-      if (word.empty()) {
-        if (c == '\n') {
-          word += EOS;
+  storage.clear();
+  while (true) {
+    const char* begin = GetArea::begin(sb);
+    const char* end = GetArea::end(sb);
+    if (begin == end) {
+      int c = sb.sgetc();
+      if (c == EOF) {
+        break;
+      }
+      if (GetArea::begin(sb) == GetArea::end(sb)) {
+        // an unbuffered streambuf, read a character at a time
+        sb.sbumpc();
+        if (!isSeparator(c)) {
+          storage.push_back(c);
+        } else if (!storage.empty()) {
+          if (c == '\n') {
+            sb.sungetc();
+          }
+          word = storage;
+          return true;
+        } else if (c == '\n') {
+          word = EOS;
           return true;
         }
+      }
+      continue;
+    }
+    // words usually start right away, the previous call having read their
+    // separator
+    if (storage.empty() && isSeparator(static_cast<unsigned char>(*begin))) {
+      do {
+        if (*begin == '\n') {
+          GetArea::bump(sb, begin + 1);
+          word = EOS;
+          return true;
+        }
+        begin++;
+      } while (begin < end && isSeparator(static_cast<unsigned char>(*begin)));
+      if (begin == end) {
+        GetArea::bump(sb, end);
         continue;
-      } else {
-        if (c == '\n')
-          sb.sungetc();
-        return true;
       }
     }
-    word.push_back(c);
+    const char* separator = findSeparator(begin, end);
+    if (separator == end) {
+      storage.append(begin, end);
+      GetArea::bump(sb, end);
+      continue;
+    }
+    if (storage.empty()) {
+      word = std::string_view(begin, separator - begin);
+    } else {
+      storage.append(begin, separator);
+      word = storage;
+    }
+    GetArea::bump(sb, *separator == '\n' ? separator : separator + 1);
+    return true;
   }
   // trigger eofbit
   in.get();
-  return !word.empty();
+  word = storage;
+  return !storage.empty();
 }
 
 void Dictionary::readFromFile(std::istream& in) {
-  std::string word;
+  std::string storage;
+  std::string_view word;
   int64_t minThreshold = 1;
-  while (readWord(in, word)) {
-    add(word);
+  std::unique_ptr<CountMinSketch> sketch;
+  if (args_->vocabSketch > 0 && args_->minCount > 1) {
+    sketch = std::make_unique<CountMinSketch>(
+        int64_t(args_->vocabSketch) << 20, SKETCH_DEPTH);
+  }
+  while (readWord(in, word, storage)) {
+    if (sketch) {
+      addSketched(word, *sketch);
+    } else {
+      add(word);
+    }
     if (ntokens_ % 1000000 == 0 && args_->verbose > 1) {
       std::cerr << "\rRead " << ntokens_ / 1000000 << "M words" << std::flush;
     }
@@ -246,11 +478,14 @@ void Dictionary::readFromFile(std::istream& in) {
   }
   threshold(args_->minCount, args_->minCountLabel);
   initTableDiscard();
-  initNgrams();
+  initNgrams(args_->thread);
   if (args_->verbose > 0) {
     std::cerr << "\rRead " << ntokens_ / 1000000 << "M words" << std::endl;
     std::cerr << "Number of words:  " << nwords_ << std::endl;
     std::cerr << "Number of labels: " << nlabels_ << std::endl;
+    if (sketch) {
+      printSketchReport(*sketch);
+    }
   }
   if (size_ == 0) {
     throw std::invalid_argument(
@@ -258,6 +493,97 @@ void Dictionary::readFromFile(std::istream& in) {
   }
 }
 
+// The counts of sketched words include what their estimate exceeded their
+// count by when they were added: reports how large this error can be, and how
+// many words it may have let through.
+void Dictionary::printSketchReport(const CountMinSketch& sketch) const {
+  double bound = sketch.errorBound();
+  int64_t uncertain = 0;
+  for (const entry& e : words_) {
+    if (e.type == entry_type::word && e.count < args_->minCount + bound) {
+      uncertain++;
+    }
+  }
+  std::cerr << "Vocabulary sketch: " << sketch.depth() << " x "
+            << sketch.width() << " counters (" << (sketch.size() >> 20)
+            << "MB)" << std::endl;
+  std::cerr << "Count error:      " << sketch.meanError(10000)
+            << " on average, at most " << int64_t(bound) << " with "
+            << int32_t(100 * sketch.confidence()) << "% probability"
+            << std::endl;
+  std::cerr << "Words within the error of minCount: " << uncertain
+            << std::endl;
+}
+
+// Adds the counts of a new file to a loaded dictionary, and the words and
+// labels that are frequent enough in it. Words keep their ids, new words come
+// after them and new labels after the labels, so that the label ids move up
+// by the number of new words. Returns the number of tokens in the file.
+int64_t Dictionary::extendFromFile(std::istream& in) {
+  if (isPruned()) {
+    throw std::invalid_argument("Cannot extend a pruned dictionary!");
+  }
+  Dictionary delta(args_);
+  std::string storage;
+  std::string_view word;
+  int64_t minThreshold = 1;
+  while (readWord(in, word, storage)) {
+    delta.add(word);
+    if (delta.ntokens_ % 1000000 == 0 && args_->verbose > 1) {
+      std::cerr << "\rRead " << delta.ntokens_ / 1000000 << "M words"
+                << std::flush;
+    }
+    if (delta.size_ > 0.75 * MAX_VOCAB_SIZE) {
+      minThreshold++;
+      delta.threshold(minThreshold, minThreshold);
+    }
+  }
+  std::vector<entry> words, labels;
+  for (auto& e : delta.words_) {
+    int32_t id = getId(e.word);
+    if (id >= 0) {
+      words_[id].count += e.count;
+    } else if (e.type == entry_type::word && e.count >= args_->minCount) {
+      words.push_back(std::move(e));
+    } else if (
+        e.type == entry_type::label && e.count >= args_->minCountLabel) {
+      labels.push_back(std::move(e));
+    }
+  }
+  auto byCount = [](const entry& e1, const entry& e2) {
+    return e1.count > e2.count;
+  };
+  std::stable_sort(words.begin(), words.end(), byCount);
+  std::stable_sort(labels.begin(), labels.end(), byCount);
+  words_.insert(
+      words_.begin() + nwords_,
+      std::make_move_iterator(words.begin()),
+      std::make_move_iterator(words.end()));
+  words_.insert(
+      words_.end(),
+      std::make_move_iterator(labels.begin()),
+      std::make_move_iterator(labels.end()));
+  nwords_ += words.size();
+  nlabels_ += labels.size();
+  size_ = words_.size();
+  ntokens_ += delta.ntokens_;
+
+  int32_t word2intsize = std::ceil(size_ / 0.7);
+  word2int_.assign(word2intsize, -1);
+  for (int32_t i = 0; i < size_; i++) {
+    word2int_[find(words_[i].word)] = i;
+  }
+  initTableDiscard();
+  initNgrams(args_->thread);
+  if (args_->verbose > 0) {
+    std::cerr << "\rRead " << delta.ntokens_ / 1000000 << "M words"
+              << std::endl;
+    std::cerr << "Number of words:  " << nwords_ << std::endl;
+    std::cerr << "Number of labels: " << nlabels_ << std::endl;
+  }
+  return delta.ntokens_;
+}
+
 void Dictionary::threshold(int64_t t, int64_t tl) {
   sort(words_.begin(), words_.end(), [](const entry& e1, const entry& e2) {
     if (e1.type != e2.type) {
@@ -339,8 +665,8 @@ void Dictionary::addSubwords(
     if (args_->maxn <= 0) { // in vocab w/o subwords
       line.push_back(wid);
     } else { // in vocab w/ subwords
-      const std::vector<int32_t>& ngrams = getSubwords(wid);
-      line.insert(line.end(), ngrams.cbegin(), ngrams.cend());
+      Span<const int32_t> ngrams = getSubwords(wid);
+      line.insert(line.end(), ngrams.begin(), ngrams.end());
     }
   }
 }
@@ -357,12 +683,13 @@ int32_t Dictionary::getLine(
     std::vector<int32_t>& words,
     std::minstd_rand& rng) const {
   std::uniform_real_distribution<> uniform(0, 1);
-  std::string token;
+  std::string storage;
+  std::string_view token;
   int32_t ntokens = 0;
 
   reset(in);
   words.clear();
-  while (readWord(in, token)) {
+  while (readWord(in, token, storage)) {
     int32_t h = find(token);
     int32_t wid = word2int_[h];
     if (wid < 0) {
@@ -385,13 +712,14 @@ int32_t Dictionary::getLine(
     std::vector<int32_t>& words,
     std::vector<int32_t>& labels) const {
   std::vector<int32_t> word_hashes;
-  std::string token;
+  std::string storage;
+  std::string_view token;
   int32_t ntokens = 0;
 
   reset(in);
   words.clear();
   labels.clear();
-  while (readWord(in, token)) {
+  while (readWord(in, token, storage)) {
     uint32_t h = hash(token);
     int32_t wid = getId(token, h);
     entry_type type = wid < 0 ? getType(token) : getType(wid);
@@ -411,6 +739,121 @@ int32_t Dictionary::getLine(
   return ntokens;
 }
 
+// Tokenizes one line the same way getLine does and appends its dictionary
+// lookups to record, so that getLine(const int32_t*, ...) can rebuild the
+// exact same input without touching the text again. Supervised records are
+//   ntokens nlabels labels... nwords (wid hash [nsubwords subwords...])...
+// where the subwords are only stored for out of vocabulary words (wid < 0).
+// Unsupervised records are
+//   ntokens wids...
+// since only in vocabulary tokens are kept and discarding happens later.
+int32_t Dictionary::encodeLine(std::istream& in, std::vector<int32_t>& record)
+    const {
+  std::string storage;
+  std::string_view token;
+  int32_t ntokens = 0;
+
+  reset(in);
+  record.clear();
+  if (args_->model != model_name::sup) {
+    record.push_back(0);
+    while (readWord(in, token, storage)) {
+      int32_t wid = getId(token);
+      if (wid < 0) {
+        continue;
+      }
+      ntokens++;
+      record.push_back(wid);
+      if (ntokens > MAX_LINE_SIZE || token == EOS) {
+        break;
+      }
+    }
+    record[0] = ntokens;
+    return ntokens;
+  }
+
+  std::vector<int32_t> labels;
+  std::vector<int32_t> words;
+  std::vector<int32_t> subwords;
+  int32_t nwords = 0;
+  while (readWord(in, token, storage)) {
+    uint32_t h = hash(token);
+    int32_t wid = getId(token, h);
+    entry_type type = wid < 0 ? getType(token) : getType(wid);
+
+    ntokens++;
+    if (type == entry_type::word) {
+      nwords++;
+      words.push_back(wid);
+      words.push_back(h);
+      if (wid < 0) {
+        subwords.clear();
+        addSubwords(subwords, token, wid);
+        words.push_back(subwords.size());
+        words.insert(words.end(), subwords.cbegin(), subwords.cend());
+      }
+    } else if (type == entry_type::label && wid >= 0) {
+      labels.push_back(wid - nwords_);
+    }
+    if (token == EOS) {
+      break;
+    }
+  }
+  record.push_back(ntokens);
+  record.push_back(labels.size());
+  record.insert(record.end(), labels.cbegin(), labels.cend());
+  record.push_back(nwords);
+  record.insert(record.end(), words.cbegin(), words.cend());
+  return ntokens;
+}
+
+int32_t Dictionary::getLine(
+    const int32_t* record,
+    std::vector<int32_t>& words,
+    std::minstd_rand& rng) const {
+  std::uniform_real_distribution<> uniform(0, 1);
+  int32_t ntokens = *record++;
+
+  words.clear();
+  for (int32_t i = 0; i < ntokens; i++) {
+    int32_t wid = record[i];
+    if (getType(wid) == entry_type::word && !discard(wid, uniform(rng))) {
+      words.push_back(wid);
+    }
+  }
+  return ntokens;
+}
+
+int32_t Dictionary::getLine(
+    const int32_t* record,
+    std::vector<int32_t>& words,
+    std::vector<int32_t>& labels) const {
+  std::vector<int32_t> word_hashes;
+  int32_t ntokens = *record++;
+  int32_t nlabels = *record++;
+
+  labels.assign(record, record + nlabels);
+  record += nlabels;
+  words.clear();
+  int32_t nwords = *record++;
+  for (int32_t i = 0; i < nwords; i++) {
+    int32_t wid = *record++;
+    word_hashes.push_back(*record++);
+    if (wid < 0) {
+      int32_t nsubwords = *record++;
+      words.insert(words.end(), record, record + nsubwords);
+      record += nsubwords;
+    } else if (args_->maxn <= 0) {
+      words.push_back(wid);
+    } else {
+      Span<const int32_t> ngrams = getSubwords(wid);
+      words.insert(words.end(), ngrams.begin(), ngrams.end());
+    }
+  }
+  addWordNgrams(words, word_hashes, args_->wordNgrams);
+  return ntokens;
+}
+
 namespace {
 bool readWordNoNewline(std::string_view& in, std::string_view& word) {
   const std::string_view spaces(" \n\r\t\v\f\0");
@@ -497,22 +940,98 @@ void Dictionary::save(std::ostream& out) const {
   }
 }
 
+// The word hash table and the subwords of every word, which load otherwise
+// computes. The table is written at the size load gives it rather than the
+// one it has while the dictionary is built, and the subwords as the offsets
+// of each word in the array of all of them.
+void Dictionary::saveIndex(std::ostream& out) const {
+  int32_t word2intsize = std::ceil(size_ / 0.7);
+  std::vector<int32_t> word2int(word2intsize, -1);
+  for (int32_t i = 0; i < size_; i++) {
+    int32_t h = hash(words_[i].word) % word2intsize;
+    while (word2int[h] != -1) {
+      h = (h + 1) % word2intsize;
+    }
+    word2int[h] = i;
+  }
+  out.write((char*)&word2intsize, sizeof(int32_t));
+  out.write((char*)word2int.data(), word2intsize * sizeof(int32_t));
+  out.write(
+      (char*)subwordOffsets_.data(), subwordOffsets_.size() * sizeof(int64_t));
+  out.write((char*)subwords_.data(), subwords_.size() * sizeof(int32_t));
+}
+
+void Dictionary::loadIndex(std::istream& in) {
+  int32_t word2intsize;
+  in.read((char*)&word2intsize, sizeof(int32_t));
+  // find probes until an empty slot, so the table needs at least one
+  if (!in || word2intsize <= size_) {
+    throw std::invalid_argument("Invalid dictionary index!");
+  }
+  word2int_.resize(word2intsize);
+  in.read((char*)word2int_.data(), word2intsize * sizeof(int32_t));
+  if (!in ||
+      std::any_of(word2int_.begin(), word2int_.end(), [&](int32_t i) {
+        return i < -1 || i >= size_;
+      })) {
+    throw std::invalid_argument("Invalid dictionary index!");
+  }
+  subwordOffsets_.resize(size_ + 1);
+  in.read(
+      (char*)subwordOffsets_.data(), subwordOffsets_.size() * sizeof(int64_t));
+  if (!in || subwordOffsets_[0] != 0 ||
+      !std::is_sorted(subwordOffsets_.begin(), subwordOffsets_.end())) {
+    throw std::invalid_argument("Invalid dictionary index!");
+  }
+  subwords_.resize(subwordOffsets_[size_]);
+  in.read((char*)subwords_.data(), subwords_.size() * sizeof(int32_t));
+  if (!in) {
+    throw std::invalid_argument("Invalid dictionary index!");
+  }
+  // the subwords of an entry are rows of the input matrix, but for the entry
+  // itself, which is a label when it is not below nwords_
+  int64_t nrows = int64_t(nwords_) + args_->bucket;
+  for (int32_t i = 0; i < size_; i++) {
+    for (int64_t j = subwordOffsets_[i]; j < subwordOffsets_[i + 1]; j++) {
+      int32_t id = subwords_[j];
+      if ((id < 0 || id >= nrows) && id != i) {
+        throw std::invalid_argument("Invalid dictionary index!");
+      }
+    }
+  }
+  initTableDiscard();
+}
+
 void Dictionary::load(std::istream& in) {
+  loadEntries(in);
+  buildIndex();
+}
+
+// The thread count saved with a model may not be usable where it is loaded,
+// as webassembly can't instantiate `std::thread`, so it is given by the caller.
+void Dictionary::buildIndex(int32_t thread) {
+  initTableDiscard();
+  initNgrams(thread);
+
+  int32_t word2intsize = std::ceil(size_ / 0.7);
+  word2int_.assign(word2intsize, -1);
+  for (int32_t i = 0; i < size_; i++) {
+    word2int_[find(words_[i].word)] = i;
+  }
+}
+
+void Dictionary::loadEntries(std::istream& in) {
   words_.clear();
   in.read((char*)&size_, sizeof(int32_t));
   in.read((char*)&nwords_, sizeof(int32_t));
   in.read((char*)&nlabels_, sizeof(int32_t));
   in.read((char*)&ntokens_, sizeof(int64_t));
   in.read((char*)&pruneidx_size_, sizeof(int64_t));
-  for (int32_t i = 0; i < size_; i++) {
-    char c;
-    entry e;
-    while ((c = in.get()) != 0) {
-      e.word.push_back(c);
-    }
+  words_.resize(size_);
+  for (auto& e : words_) {
+    std::getline(in, e.word, '\0');
     in.read((char*)&e.count, sizeof(int64_t));
     in.read((char*)&e.type, sizeof(entry_type));
-    words_.push_back(e);
   }
   pruneidx_.clear();
   for (int32_t i = 0; i < pruneidx_size_; i++) {
@@ -522,19 +1041,11 @@ void Dictionary::load(std::istream& in) {
     in.read((char*)&second, sizeof(int32_t));
     pruneidx_[first] = second;
   }
-  initTableDiscard();
-  initNgrams();
-
-  int32_t word2intsize = std::ceil(size_ / 0.7);
-  word2int_.assign(word2intsize, -1);
-  for (int32_t i = 0; i < size_; i++) {
-    word2int_[find(words_[i].word)] = i;
-  }
 }
 
 void Dictionary::init() {
   initTableDiscard();
-  initNgrams();
+  initNgrams(args_->thread);
 }
 
 void Dictionary::prune(std::vector<int32_t>& idx) {
@@ -546,7 +1057,10 @@ void Dictionary::prune(std::vector<int32_t>& idx) {
       ngrams.push_back(*it);
     }
   }
+  // the rows are kept in increasing order, which lets DenseMatrix::compactRows
+  // move them forward in place
   std::sort(words.begin(), words.end());
+  std::sort(ngrams.begin(), ngrams.end());
   idx = words;
 
   if (ngrams.size() != 0) {
@@ -19,35 +19,48 @@
 
 #include "args.h"
 #include "real.h"
+#include "span.h"
 
 namespace fasttext {
 
+class CountMinSketch;
+
 typedef int32_t id_type;
 enum class entry_type : int8_t { word = 0, label = 1 };
+// Where a loaded dictionary gets its index (word2int_ and the subwords) from:
+// built from the entries, read after them, or left to buildIndex.
+enum class index_source : int8_t { build = 0, stored = 1, deferred = 2 };
 
 struct entry {
   std::string word;
   int64_t count;
   entry_type type;
-  std::vector<int32_t> subwords;
 };
 
 class Dictionary {
  protected:
   static const int32_t MAX_VOCAB_SIZE = 30000000;
-  static const int32_t MAX_LINE_SIZE = 1024;
+  static const int32_t SKETCH_DEPTH = 4;
 
   int32_t find(const std::string_view) const;
   int32_t find(const std::string_view, uint32_t h) const;
   void initTableDiscard();
-  void initNgrams();
+  void initNgrams(int32_t thread = 1);
   void reset(std::istream&) const;
+  void loadEntries(std::istream&);
+  void loadIndex(std::istream&);
+  void addSketched(std::string_view, CountMinSketch&);
+  void printSketchReport(const CountMinSketch&) const;
   void pushHash(std::vector<int32_t>&, int32_t) const;
   void addSubwords(std::vector<int32_t>&, const std::string_view, int32_t) const;
 
   std::shared_ptr<Args> args_;
   std::vector<int32_t> word2int_;
   std::vector<entry> words_;
+  // The subwords of word i are subwords_[subwordOffsets_[i]] up to
+  // subwords_[subwordOffsets_[i + 1]], all of them in one array.
+  std::vector<int32_t> subwords_;
+  std::vector<int64_t> subwordOffsets_;
 
   std::vector<real> pdiscard_;
   int32_t size_;
@@ -63,12 +76,19 @@ class Dictionary {
       int32_t n) const;
 
  public:
+  static const int32_t MAX_LINE_SIZE = 1024;
   static const std::string EOS;
   static const std::string BOW;
   static const std::string EOW;
 
   explicit Dictionary(std::shared_ptr<Args>);
-  explicit Dictionary(std::shared_ptr<Args>, std::istream&);
+  // With index_source::stored, the entries are followed by what saveIndex
+  // writes.
+  explicit Dictionary(
+      std::shared_ptr<Args>,
+      std::istream&,
+      index_source index = index_source::build);
+  explicit Dictionary(std::shared_ptr<Args>, const Dictionary&);
   int32_t nwords() const;
   int32_t nlabels() const;
   int64_t ntokens() const;
@@ -78,7 +98,7 @@ class Dictionary {
   entry_type getType(const std::string_view) const;
   bool discard(int32_t, real) const;
   std::string getWord(int32_t) const;
-  const std::vector<int32_t>& getSubwords(int32_t) const;
+  Span<const int32_t> getSubwords(int32_t) const;
   const std::vector<int32_t> getSubwords(const std::string&) const;
   void getSubwords(
       const std::string&,
@@ -89,12 +109,19 @@ class Dictionary {
       std::vector<int32_t>&,
       std::vector<std::string>* substrings = nullptr) const;
   uint32_t hash(const std::string_view str) const;
-  void add(const std::string&);
+  void add(std::string_view);
   bool readWord(std::istream&, std::string&) const;
+  // Sets word to a view of the stream buffer, or of storage when the word is
+  // not in one piece there, which stays valid until the stream is used again.
+  bool readWord(std::istream&, std::string_view& word, std::string& storage)
+      const;
   void readFromFile(std::istream&);
+  int64_t extendFromFile(std::istream&);
   std::string getLabel(int32_t) const;
   void save(std::ostream&) const;
+  void saveIndex(std::ostream&) const;
   void load(std::istream&);
+  void buildIndex(int32_t thread = 1);
   std::vector<int64_t> getCounts(entry_type) const;
   int32_t getLine(std::istream&, std::vector<int32_t>&, std::vector<int32_t>&)
       const;
@@ -102,6 +129,11 @@ class Dictionary {
       const;
   int32_t getStringNoNewline(std::string_view, std::vector<int32_t>&,
       std::vector<int32_t>&) const;
+  int32_t encodeLine(std::istream&, std::vector<int32_t>&) const;
+  int32_t getLine(const int32_t*, std::vector<int32_t>&, std::vector<int32_t>&)
+      const;
+  int32_t getLine(const int32_t*, std::vector<int32_t>&, std::minstd_rand&)
+      const;
   void threshold(int64_t, int64_t);
   void prune(std::vector<int32_t>&);
   bool isPruned() {
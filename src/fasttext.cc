@@ -7,10 +7,15 @@
  */
 
 #include "fasttext.h"
+#include "compression.h"
+#include "halfmatrix.h"
+#include "int8matrix.h"
 #include "loss.h"
 #include "quantmatrix.h"
+#include "wordvectors.h"
 
 #include <algorithm>
+#include <cstdio>
 #include <iomanip>
 #include <iostream>
 #include <numeric>
@@ -20,10 +25,179 @@
 #include <thread>
 #include <vector>
 
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<charconv>)
+#include <charconv>
+#endif
+#endif
+
 namespace fasttext {
 
-constexpr int32_t FASTTEXT_VERSION = 12; /* Version 1b */
+constexpr int32_t FASTTEXT_VERSION = 15; /* Version 1e */
 constexpr int32_t FASTTEXT_FILEFORMAT_MAGIC_INT32 = 793712314;
+// Since version 14, the header is followed by a table of the sections of the
+// model, so that a loader can go straight to the ones it needs, and the
+// dictionary section holds its word hash table and subwords.
+constexpr int32_t kFirstSectionTableVersion = 14;
+// Since version 15, a section can be compressed, as its flags tell.
+constexpr uint32_t kCompressedSection = 1;
+constexpr uint32_t kArgsSection = 1;
+constexpr uint32_t kDictionarySection = 2;
+constexpr uint32_t kInputSection = 3;
+constexpr uint32_t kOutputSection = 4;
+constexpr int32_t kMaxSections = 64;
+constexpr int64_t kLoadBufferSize = 1 << 20;
+
+// A checkpoint is a model file followed by this magic number, the number of
+// tokens processed when it was saved and the number of tokens in an epoch.
+constexpr int32_t CHECKPOINT_MAGIC_INT32 = 793712317;
+
+// Written before each matrix of a model since version 13, in place of the
+// bools that used to tell whether it was product quantized.
+constexpr int32_t kFirstMatrixTypeVersion = 13;
+constexpr uint8_t kDenseMatrix = 0;
+constexpr uint8_t kQuantMatrix = 1;
+constexpr uint8_t kInt8Matrix = 2;
+constexpr uint8_t kHalfMatrix = 3;
+
+// Number of words formatted in memory at a time by saveVectors.
+constexpr int64_t kSaveVectorsChunkSize = 1 << 16;
+
+// Appends the word and the values of vec the way `out << word << " " << vec`
+// writes them, i.e. as printf's %.5g, without going through a stream.
+void appendWordVector(std::string& out, const std::string& word, const Vector& vec) {
+  char buffer[32];
+  out += word;
+  out += ' ';
+  for (int64_t j = 0; j < vec.size(); j++) {
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    char* end = std::to_chars(
+                    buffer,
+                    buffer + sizeof(buffer),
+                    vec[j],
+                    std::chars_format::general,
+                    5)
+                    .ptr;
+    out.append(buffer, end);
+#else
+    out.append(buffer, std::snprintf(buffer, sizeof(buffer), "%.5g", vec[j]));
+#endif
+    out += ' ';
+  }
+  out += '\n';
+}
+
+// Offsets are counted from the magic number of the model.
+struct ModelSection {
+  uint32_t id;
+  uint32_t flags;
+  int64_t offset;
+  int64_t size;
+};
+
+void writeSectionTable(
+    std::ostream& out,
+    const std::vector<ModelSection>& sections) {
+  int32_t count = sections.size();
+  out.write((char*)&count, sizeof(int32_t));
+  for (const auto& section : sections) {
+    out.write((char*)&section.id, sizeof(uint32_t));
+    out.write((char*)&section.flags, sizeof(uint32_t));
+    out.write((char*)&section.offset, sizeof(int64_t));
+    out.write((char*)&section.size, sizeof(int64_t));
+  }
+}
+
+// Returns the sections ordered by offset.
+std::vector<ModelSection> readSectionTable(std::istream& in) {
+  int32_t count = 0;
+  in.read((char*)&count, sizeof(int32_t));
+  if (!in || count < 0 || count > kMaxSections) {
+    throw std::invalid_argument("Invalid model section table!");
+  }
+  std::vector<ModelSection> sections(count);
+  for (auto& section : sections) {
+    in.read((char*)&section.id, sizeof(uint32_t));
+    in.read((char*)&section.flags, sizeof(uint32_t));
+    in.read((char*)&section.offset, sizeof(int64_t));
+    in.read((char*)&section.size, sizeof(int64_t));
+  }
+  if (!in) {
+    throw std::invalid_argument("Invalid model section table!");
+  }
+  for (const auto& section : sections) {
+    if (section.flags & ~kCompressedSection) {
+      throw std::invalid_argument("Unsupported model section flags!");
+    }
+  }
+  std::sort(
+      sections.begin(),
+      sections.end(),
+      [](const ModelSection& s1, const ModelSection& s2) {
+        return s1.offset < s2.offset;
+      });
+  return sections;
+}
+
+const char* getSectionName(uint32_t id) {
+  switch (id) {
+    case kArgsSection:
+      return "args";
+    case kDictionarySection:
+      return "dictionary";
+    case kInputSection:
+      return "input";
+    case kOutputSection:
+      return "output";
+  }
+  return "unknown";
+}
+
+int64_t sectionTableSize(int32_t count) {
+  return sizeof(int32_t) + count * (2 * sizeof(uint32_t) + 2 * sizeof(int64_t));
+}
+
+uint8_t getMatrixType(const std::shared_ptr<Matrix>& matrix) {
+  if (std::dynamic_pointer_cast<QuantMatrix>(matrix)) {
+    return kQuantMatrix;
+  }
+  if (std::dynamic_pointer_cast<Int8Matrix>(matrix)) {
+    return kInt8Matrix;
+  }
+  if (std::dynamic_pointer_cast<HalfMatrix>(matrix)) {
+    return kHalfMatrix;
+  }
+  return kDenseMatrix;
+}
+
+std::shared_ptr<Matrix> createMatrix(uint8_t type) {
+  switch (type) {
+    case kDenseMatrix:
+      return std::make_shared<DenseMatrix>();
+    case kQuantMatrix:
+      return std::make_shared<QuantMatrix>();
+    case kInt8Matrix:
+      return std::make_shared<Int8Matrix>();
+    case kHalfMatrix:
+      return std::make_shared<HalfMatrix>();
+  }
+  throw std::invalid_argument(
+      "Unsupported matrix type " + std::to_string(type) + "!");
+}
+
+// Dense matrices are converted while they are read when a half precision
+// format is given.
+std::shared_ptr<Matrix>
+loadMatrix(std::istream& in, uint8_t type, const std::string& half) {
+  if (type == kDenseMatrix && !half.empty()) {
+    auto matrix = std::make_shared<HalfMatrix>(half == "bf16");
+    matrix->loadDense(in);
+    return matrix;
+  }
+  auto matrix = createMatrix(type);
+  matrix->load(in);
+  return matrix;
+}
 
 bool comparePairs(
     const std::pair<real, std::string>& l,
@@ -108,15 +282,24 @@ int32_t FastText::getLabelId(const std::string& label) const {
   return labelId;
 }
 
+// The rows are averaged by the matrix, as for the hidden vector of the model,
+// so that a rotated quantized matrix rotates back their sum only once.
 void FastText::getWordVector(Vector& vec, const std::string& word) const {
   const std::vector<int32_t>& ngrams = dict_->getSubwords(word);
-  vec.zero();
-  for (int i = 0; i < ngrams.size(); i++) {
-    addInputVector(vec, ngrams[i]);
+  if (ngrams.empty()) {
+    vec.zero();
+    return;
   }
-  if (ngrams.size() > 0) {
-    vec.mul(1.0 / ngrams.size());
+  input_->averageRowsToVector(vec, ngrams);
+}
+
+void FastText::getWordVector(Vector& vec, int32_t wordId) const {
+  Span<const int32_t> ngrams = dict_->getSubwords(wordId);
+  if (ngrams.empty()) {
+    vec.zero();
+    return;
   }
+  input_->averageRowsToVector(vec, ngrams);
 }
 
 void FastText::getSubwordVector(Vector& vec, const std::string& subword) const {
@@ -126,21 +309,47 @@ void FastText::getSubwordVector(Vector& vec, const std::string& subword) const {
   addInputVector(vec, h);
 }
 
-void FastText::saveVectors(const std::string& filename) {
+void FastText::saveVectors(const std::string& filename, bool binary) {
   if (!input_ || !output_) {
     throw std::runtime_error("Model never trained");
   }
-  std::ofstream ofs(filename);
+  std::ofstream ofs(
+      filename, binary ? std::ofstream::binary : std::ofstream::out);
   if (!ofs.is_open()) {
     throw std::invalid_argument(
         filename + " cannot be opened for saving vectors!");
   }
+  const int32_t thread = std::max(args_->thread, 1);
+  if (binary) {
+    WordVectors::saveBinary(
+        ofs,
+        dict_->nwords(),
+        args_->dim,
+        [this](int64_t i) { return dict_->getWord(i); },
+        [this](int64_t i, Vector& vec) { getWordVector(vec, i); },
+        thread);
+    ofs.close();
+    return;
+  }
   ofs << dict_->nwords() << " " << args_->dim << std::endl;
-  Vector vec(args_->dim);
-  for (int32_t i = 0; i < dict_->nwords(); i++) {
-    std::string word = dict_->getWord(i);
-    getWordVector(vec, word);
-    ofs << word << " " << vec << std::endl;
+  // The words are formatted in chunks, each thread writing its share of a
+  // chunk to its own buffer, and the buffers are written in order.
+  const int64_t nwords = dict_->nwords();
+  std::vector<std::string> buffers(thread);
+  for (int64_t chunk = 0; chunk < nwords; chunk += kSaveVectorsChunkSize) {
+    const int64_t size = std::min(kSaveVectorsChunkSize, nwords - chunk);
+    int32_t ranges = utils::parallelForThreads(
+        size, thread, [&](int32_t t, int64_t begin, int64_t end) {
+          Vector vec(args_->dim);
+          buffers[t].clear();
+          for (auto i = chunk + begin; i < chunk + end; i++) {
+            getWordVector(vec, i);
+            appendWordVector(buffers[t], dict_->getWord(i), vec);
+          }
+        });
+    for (int32_t t = 0; t < ranges; t++) {
+      ofs << buffers[t];
+    }
   }
   ofs.close();
 }
@@ -189,36 +398,212 @@ void FastText::signModel(std::ostream& out) {
   out.write((char*)&(version), sizeof(int32_t));
 }
 
-void FastText::saveModel(const std::string& filename) {
+void FastText::saveModel(std::ostream& out, bool compress) {
+  if (!input_ || !output_) {
+    throw std::runtime_error("Model never trained");
+  }
+  const std::streampos start = out.tellp();
+  if (start == std::streampos(-1)) {
+    throw std::invalid_argument("Models can only be saved to files!");
+  }
+  signModel(out);
+  std::vector<ModelSection> sections;
+  // the table is written once the sections are, when their sizes are known
+  const std::streampos table = out.tellp();
+  out.seekp(sectionTableSize(4), std::ios_base::cur);
+  auto writeSection = [&](uint32_t id,
+                          bool compressed,
+                          const std::function<void(std::ostream&)>& write) {
+    int64_t offset = out.tellp() - start;
+    if (compressed) {
+      CompressedOutputBuffer buffer(out, args_->thread);
+      std::ostream stream(&buffer);
+      write(stream);
+      buffer.close();
+    } else {
+      write(out);
+    }
+    sections.push_back({id,
+                        compressed ? kCompressedSection : 0,
+                        offset,
+                        (out.tellp() - start) - offset});
+  };
+  writeSection(kArgsSection, false, [&](std::ostream& o) { args_->save(o); });
+  writeSection(kDictionarySection, compress, [&](std::ostream& o) {
+    dict_->save(o);
+    dict_->saveIndex(o);
+  });
+  writeSection(kInputSection, compress, [&](std::ostream& o) {
+    uint8_t inputType = getMatrixType(input_);
+    o.write((char*)&(inputType), sizeof(uint8_t));
+    input_->save(o);
+  });
+  writeSection(kOutputSection, compress, [&](std::ostream& o) {
+    uint8_t outputType = getMatrixType(output_);
+    o.write((char*)&(outputType), sizeof(uint8_t));
+    output_->save(o);
+  });
+  const std::streampos end = out.tellp();
+  out.seekp(table);
+  writeSectionTable(out, sections);
+  out.seekp(end);
+}
+
+void FastText::saveModel(const std::string& filename, bool compress) {
   std::ofstream ofs(filename, std::ofstream::binary);
   if (!ofs.is_open()) {
     throw std::invalid_argument(filename + " cannot be opened for saving!");
   }
-  if (!input_ || !output_) {
-    throw std::runtime_error("Model never trained");
-  }
-  signModel(ofs);
-  args_->save(ofs);
-  dict_->save(ofs);
+  saveModel(ofs, compress);
+  ofs.close();
+}
 
-  ofs.write((char*)&(quant_), sizeof(bool));
-  input_->save(ofs);
+void FastText::saveCheckpoint(const std::string& filename, int64_t tokenCount) {
+  // The previous checkpoint is only replaced once the new one is complete,
+  // so that a crash while saving does not lose both.
+  const std::string tmpFilename = filename + ".tmp";
+  std::ofstream ofs(tmpFilename, std::ofstream::binary);
+  if (!ofs.is_open()) {
+    throw std::invalid_argument(
+        tmpFilename + " cannot be opened for saving!");
+  }
+  saveModel(ofs);
+  const int32_t magic = CHECKPOINT_MAGIC_INT32;
+  ofs.write((char*)&(magic), sizeof(int32_t));
+  ofs.write((char*)&(tokenCount), sizeof(int64_t));
+  ofs.write((char*)&(epochTokens_), sizeof(int64_t));
+  ofs.close();
+  if (!ofs) {
+    throw std::runtime_error(tmpFilename + " could not be written!");
+  }
+  if (std::rename(tmpFilename.c_str(), filename.c_str()) != 0) {
+    // rename does not replace an existing file on Windows
+    std::remove(filename.c_str());
+    if (std::rename(tmpFilename.c_str(), filename.c_str()) != 0) {
+      throw std::runtime_error(
+          tmpFilename + " could not be renamed to " + filename + "!");
+    }
+  }
+}
 
-  ofs.write((char*)&(args_->qout), sizeof(bool));
-  output_->save(ofs);
+void FastText::loadTrainableModel(std::istream& in, const std::string& name) {
+  if (!checkModel(in)) {
+    throw std::invalid_argument(name + " has wrong file format!");
+  }
+  // Only the options that define the model are saved with it, the others,
+  // such as lr and thread, are those given for this run.
+  loadSections(in, "");
+  if (quant_ || args_->qout) {
+    throw std::invalid_argument(
+        name + " is quantized, only float models can be trained further!");
+  }
+}
 
-  ofs.close();
+int64_t FastText::loadCheckpoint(const std::string& filename) {
+  std::ifstream ifs(filename, std::ifstream::binary);
+  if (!ifs.is_open()) {
+    throw std::invalid_argument(filename + " cannot be opened for loading!");
+  }
+  loadTrainableModel(ifs, filename);
+  int32_t magic = 0;
+  int64_t tokenCount = 0;
+  ifs.read((char*)&(magic), sizeof(int32_t));
+  ifs.read((char*)&(tokenCount), sizeof(int64_t));
+  ifs.read((char*)&(epochTokens_), sizeof(int64_t));
+  if (!ifs || magic != CHECKPOINT_MAGIC_INT32) {
+    throw std::invalid_argument(filename + " is not a training checkpoint!");
+  }
+  ifs.close();
+  return tokenCount;
 }
 
-void FastText::loadModel(const std::string& filename) {
+void FastText::loadInputModel(const std::string& filename) {
+  if (!args_->pretrainedVectors.empty()) {
+    throw std::invalid_argument(
+        "Pretrained vectors cannot be used with an input model!");
+  }
+  const Args args = *args_;
   std::ifstream ifs(filename, std::ifstream::binary);
   if (!ifs.is_open()) {
     throw std::invalid_argument(filename + " cannot be opened for loading!");
   }
+  loadTrainableModel(ifs, filename);
+  ifs.close();
+  if (args_->model != args.model) {
+    throw std::invalid_argument(
+        filename + " was not trained with the same command!");
+  }
+  if (args_->loss == loss_name::hs) {
+    // the tree is built from the counts, which the new data changes
+    throw std::invalid_argument(
+        "Models trained with the hs loss cannot be trained further!");
+  }
+  // the number of epochs and the thresholds are those of the new data
+  args_->epoch = args.epoch;
+  args_->minCount = args.minCount;
+  args_->minCountLabel = args.minCountLabel;
+  args_->lrUpdateRate = args.lrUpdateRate;
+  args_->t = args.t;
+
+  std::ifstream in(args_->input);
+  if (!in.is_open()) {
+    throw std::invalid_argument(
+        args_->input + " cannot be opened for training!");
+  }
+  const int32_t nwords = dict_->nwords();
+  const int32_t nlabels = dict_->nlabels();
+  epochTokens_ = dict_->extendFromFile(in);
+  in.close();
+
+  // The rows of the words and labels that were already there are kept, new
+  // words start from random vectors and new targets from zero.
+  std::shared_ptr<DenseMatrix> oldInput =
+      std::dynamic_pointer_cast<DenseMatrix>(input_);
+  std::shared_ptr<DenseMatrix> oldOutput =
+      std::dynamic_pointer_cast<DenseMatrix>(output_);
+  std::shared_ptr<DenseMatrix> input =
+      std::dynamic_pointer_cast<DenseMatrix>(createRandomMatrix());
+  const int64_t dim = args_->dim;
+  std::copy(
+      oldInput->data(),
+      oldInput->data() + nwords * dim,
+      input->data());
+  std::copy(
+      oldInput->data() + nwords * dim,
+      oldInput->data() + oldInput->size(0) * dim,
+      input->data() + dict_->nwords() * dim);
+  oldInput.reset();
+  input_ = input;
+  std::shared_ptr<DenseMatrix> output =
+      std::dynamic_pointer_cast<DenseMatrix>(createTrainOutputMatrix());
+  std::copy(
+      oldOutput->data(),
+      oldOutput->data() + oldOutput->size(0) * dim,
+      output->data());
+  output_ = output;
+  if (args_->verbose > 0) {
+    std::cerr << "New words:  " << dict_->nwords() - nwords << std::endl;
+    std::cerr << "New labels: " << dict_->nlabels() - nlabels << std::endl;
+  }
+}
+
+void FastText::loadModel(
+    const std::string& filename,
+    const std::string& half,
+    int32_t thread) {
+  // the dictionary entries and the other small fields are read from a larger
+  // buffer than the default one
+  std::vector<char> buffer(kLoadBufferSize);
+  std::ifstream ifs;
+  ifs.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+  ifs.open(filename, std::ifstream::binary);
+  if (!ifs.is_open()) {
+    throw std::invalid_argument(filename + " cannot be opened for loading!");
+  }
   if (!checkModel(ifs)) {
     throw std::invalid_argument(filename + " has wrong file format!");
   }
-  loadModel(ifs);
+  loadModel(ifs, half, thread);
   ifs.close();
 }
 
@@ -236,39 +621,216 @@ void FastText::buildModel() {
   model_ = std::make_shared<Model>(input_, output_, loss, normalizeGradient);
 }
 
-void FastText::loadModel(std::istream& in) {
+void FastText::loadModel(
+    std::istream& in,
+    const std::string& half,
+    int32_t thread) {
+  if (!half.empty() && half != "fp16" && half != "bf16") {
+    throw std::invalid_argument(
+        "Unsupported half precision format " + half + "!");
+  }
+  auto start = std::chrono::steady_clock::now();
+  loadTimes_.clear();
   args_ = std::make_shared<Args>();
   input_ = std::make_shared<DenseMatrix>();
   output_ = std::make_shared<DenseMatrix>();
-  args_->load(in);
-  if (version == 11 && args_->model == model_name::sup) {
-    // backward compatibility: old supervised models do not use char ngrams.
-    args_->maxn = 0;
+  loadSections(in, half, thread);
+  auto modelStart = std::chrono::steady_clock::now();
+  buildModel();
+  auto end = std::chrono::steady_clock::now();
+  loadTimes_.emplace_back("model", utils::getDuration(modelStart, end));
+  loadTimes_.emplace_back("total", utils::getDuration(start, end));
+}
+
+const std::vector<std::pair<std::string, double>>& FastText::getLoadTimes()
+    const {
+  return loadTimes_;
+}
+
+void FastText::loadSections(
+    std::istream& in,
+    const std::string& half,
+    int32_t thread) {
+  if (version < kFirstSectionTableVersion) {
+    if (thread > 1) {
+      loadUnindexedSections(in, half, thread);
+      return;
+    }
+    for (uint32_t id : {kArgsSection,
+                        kDictionarySection,
+                        kInputSection,
+                        kOutputSection}) {
+      loadSection(in, id, half);
+    }
+    return;
   }
-  dict_ = std::make_shared<Dictionary>(args_, in);
+  // The sections are read in the order they are stored, skipping the ones
+  // this version does not know, so that the stream does not need to seek.
+  int64_t position = 2 * sizeof(int32_t);
+  std::vector<ModelSection> sections = readSectionTable(in);
+  position += sectionTableSize(sections.size());
+  int32_t loaded = 0;
+  for (const auto& section : sections) {
+    if (section.offset < position) {
+      throw std::invalid_argument("Invalid model section table!");
+    }
+    in.ignore(section.offset - position);
+    if (section.id >= kArgsSection && section.id <= kOutputSection) {
+      if (section.flags & kCompressedSection) {
+        loadCompressedSection(in, section.id, half, thread);
+      } else {
+        loadSection(in, section.id, half);
+      }
+      loaded++;
+    } else {
+      in.ignore(section.size);
+    }
+    position = section.offset + section.size;
+  }
+  if (!in || loaded != 4) {
+    throw std::invalid_argument("Model file is truncated!");
+  }
+}
 
-  bool quant_input;
-  in.read((char*)&quant_input, sizeof(bool));
-  if (quant_input) {
-    quant_ = true;
-    input_ = std::make_shared<QuantMatrix>();
+// Models saved before the dictionary index are read sequentially too, but the
+// index is built from the entries on the other threads while this one reads
+// the matrices.
+void FastText::loadUnindexedSections(
+    std::istream& in,
+    const std::string& half,
+    int32_t thread) {
+  loadSection(in, kArgsSection, half);
+  auto start = std::chrono::steady_clock::now();
+  dict_ = std::make_shared<Dictionary>(args_, in, index_source::deferred);
+  loadTimes_.emplace_back(
+      getSectionName(kDictionarySection),
+      utils::getDuration(start, std::chrono::steady_clock::now()));
+  double indexTime = 0.0;
+  std::exception_ptr exception;
+  std::thread indexThread([&]() {
+    auto indexStart = std::chrono::steady_clock::now();
+    try {
+      dict_->buildIndex(thread - 1);
+    } catch (...) {
+      exception = std::current_exception();
+    }
+    indexTime =
+        utils::getDuration(indexStart, std::chrono::steady_clock::now());
+  });
+  try {
+    loadSection(in, kInputSection, half);
+    loadSection(in, kOutputSection, half);
+  } catch (...) {
+    indexThread.join();
+    throw;
   }
-  input_->load(in);
+  indexThread.join();
+  if (exception) {
+    std::rethrow_exception(exception);
+  }
+  loadTimes_.emplace_back("index", indexTime);
+}
 
-  if (!quant_input && dict_->isPruned()) {
-    throw std::invalid_argument(
-        "Invalid model file.\n"
-        "Please download the updated model from www.fasttext.cc.\n"
-        "See issue #332 on Github for more information.\n");
+// The blocks of a compressed section are decompressed thread at a time where
+// it is read in large chunks, such as the values of a matrix, which land
+// straight in the matrix.
+void FastText::loadCompressedSection(
+    std::istream& in,
+    uint32_t id,
+    const std::string& half,
+    int32_t thread) {
+  CompressedInputBuffer buffer(in, thread);
+  std::istream stream(&buffer);
+  // errors in the compressed data are thrown as they are
+  stream.exceptions(std::istream::badbit);
+  loadSection(stream, id, half);
+  if (!stream) {
+    throw std::invalid_argument("Model file is truncated!");
   }
+  buffer.skipToEnd();
+}
 
-  in.read((char*)&args_->qout, sizeof(bool));
-  if (quant_ && args_->qout) {
-    output_ = std::make_shared<QuantMatrix>();
+void FastText::loadSection(
+    std::istream& in,
+    uint32_t id,
+    const std::string& half) {
+  auto start = std::chrono::steady_clock::now();
+  if (id == kArgsSection) {
+    args_->load(in);
+    if (version == 11 && args_->model == model_name::sup) {
+      // backward compatibility: old supervised models do not use char ngrams.
+      args_->maxn = 0;
+    }
+  } else if (id == kDictionarySection) {
+    dict_ = std::make_shared<Dictionary>(
+        args_,
+        in,
+        version >= kFirstSectionTableVersion ? index_source::stored
+                                             : index_source::build);
+  } else if (id == kInputSection) {
+    uint8_t inputType;
+    in.read((char*)&inputType, sizeof(uint8_t));
+    if (!in) {
+      throw std::invalid_argument("Model file is truncated!");
+    }
+    input_ = loadMatrix(in, inputType, half);
+    quant_ = getMatrixType(input_) != kDenseMatrix;
+
+    if (inputType == kDenseMatrix && dict_->isPruned()) {
+      throw std::invalid_argument(
+          "Invalid model file.\n"
+          "Please download the updated model from www.fasttext.cc.\n"
+          "See issue #332 on Github for more information.\n");
+    }
+  } else if (id == kOutputSection) {
+    uint8_t outputType;
+    in.read((char*)&outputType, sizeof(uint8_t));
+    if (!in) {
+      throw std::invalid_argument("Model file is truncated!");
+    }
+    if (version < kFirstMatrixTypeVersion) {
+      // the byte is args.qout, which older versions only applied to the
+      // output of a quantized model
+      outputType = outputType && quant_ ? kQuantMatrix : kDenseMatrix;
+    }
+    output_ = loadMatrix(in, outputType, half);
+    args_->qout = getMatrixType(output_) != kDenseMatrix;
   }
-  output_->load(in);
+  loadTimes_.emplace_back(
+      getSectionName(id),
+      utils::getDuration(start, std::chrono::steady_clock::now()));
+}
 
-  buildModel();
+void FastText::loadDictionary(const std::string& filename) {
+  std::ifstream ifs(filename, std::ifstream::binary);
+  if (!ifs.is_open()) {
+    throw std::invalid_argument(filename + " cannot be opened for loading!");
+  }
+  if (!checkModel(ifs)) {
+    throw std::invalid_argument(filename + " has wrong file format!");
+  }
+  loadTimes_.clear();
+  args_ = std::make_shared<Args>();
+  if (version < kFirstSectionTableVersion) {
+    loadSection(ifs, kArgsSection, "");
+    loadSection(ifs, kDictionarySection, "");
+    return;
+  }
+  int32_t loaded = 0;
+  for (const auto& section : readSectionTable(ifs)) {
+    if (section.id == kArgsSection || section.id == kDictionarySection) {
+      ifs.seekg(section.offset);
+      if (section.flags & kCompressedSection) {
+        loadCompressedSection(ifs, section.id, "", 1);
+      } else {
+        loadSection(ifs, section.id, "");
+      }
+      loaded++;
+    }
+  }
+  if (!ifs || loaded != 2) {
+    throw std::invalid_argument(filename + " is truncated!");
+  }
 }
 
 std::tuple<int64_t, double, double> FastText::progressInfo(real progress) {
@@ -278,9 +840,12 @@ std::tuple<int64_t, double, double> FastText::progressInfo(real progress) {
 
   int64_t eta = 2592000; // Default to one month in seconds (720 * 3600)
 
-  if (progress > 0 && t >= 0) {
-    eta = t * (1 - progress) / progress;
-    wst = double(tokenCount_) / t / args_->thread;
+  // only the tokens processed since training started or resumed count
+  const double startProgress =
+      double(startTokenCount_) / (args_->epoch * epochTokens_);
+  if (progress > startProgress && t >= 0) {
+    eta = t * (1 - progress) / (progress - startProgress);
+    wst = double(tokenCount_ - startTokenCount_) / t / args_->thread;
   }
 
   return std::tuple<double, double, int64_t>(wst, lr, eta);
@@ -302,29 +867,57 @@ void FastText::printInfo(real progress, real loss, std::ostream& log_stream) {
   log_stream << std::flush;
 }
 
-std::vector<int32_t> FastText::selectEmbeddings(int32_t cutoff) const {
+std::vector<int32_t> FastText::selectEmbeddings(
+    int32_t cutoff,
+    int32_t thread) const {
   std::shared_ptr<DenseMatrix> input =
       std::dynamic_pointer_cast<DenseMatrix>(input_);
   Vector norms(input->size(0));
-  input->l2NormRow(norms);
+  input->l2NormRow(norms, thread);
   std::vector<int32_t> idx(input->size(0), 0);
   std::iota(idx.begin(), idx.end(), 0);
   auto eosid = dict_->getId(Dictionary::EOS);
-  std::sort(idx.begin(), idx.end(), [&norms, eosid](size_t i1, size_t i2) {
-    if (i1 == eosid && i2 == eosid) { // satisfy strict weak ordering
-      return false;
+  // EOS first, then by decreasing norm; ties are broken by id so that the
+  // selection does not depend on the order nth_element leaves them in.
+  auto compare = [&norms, eosid](int32_t i1, int32_t i2) {
+    if (i1 == eosid || i2 == eosid) {
+      return i1 == eosid && i2 != eosid;
     }
-    return eosid == i1 || (eosid != i2 && norms[i1] > norms[i2]);
-  });
+    if (norms[i1] != norms[i2]) {
+      return norms[i1] > norms[i2];
+    }
+    return i1 < i2;
+  };
+  std::nth_element(idx.begin(), idx.begin() + cutoff, idx.end(), compare);
   idx.erase(idx.begin() + cutoff, idx.end());
+  std::sort(idx.begin(), idx.end(), compare);
   return idx;
 }
 
 void FastText::quantize(const Args& qargs, const TrainCallback& callback) {
-  if (args_->model != model_name::sup) {
+  if (args_->model != model_name::sup && qargs.half.empty()) {
     throw std::invalid_argument(
         "For now we only support quantization of supervised models");
   }
+  if (!qargs.half.empty() && qargs.half != "fp16" && qargs.half != "bf16") {
+    throw std::invalid_argument(
+        "Unsupported half precision format " + qargs.half + "!");
+  }
+  if (qargs.int8 && !qargs.half.empty()) {
+    throw std::invalid_argument("-int8 and -half cannot be used together!");
+  }
+  // the options of product quantization would otherwise be silently ignored
+  if ((qargs.int8 || !qargs.half.empty()) &&
+      (qargs.isManual("dsub") || qargs.isManual("nbits") || qargs.qnorm ||
+       qargs.opq)) {
+    throw std::invalid_argument(
+        std::string(qargs.int8 ? "-int8" : "-half") +
+        " cannot be used with -dsub, -nbits, -qnorm or -opq!");
+  }
+  if (qargs.half.empty() && !qargs.int8 && qargs.nbits != 4 &&
+      qargs.nbits != 8) {
+    throw std::invalid_argument("-nbits must be 4 or 8");
+  }
   args_->input = qargs.input;
   args_->qout = qargs.qout;
   args_->output = qargs.output;
@@ -335,32 +928,60 @@ void FastText::quantize(const Args& qargs, const TrainCallback& callback) {
   bool normalizeGradient = (args_->model == model_name::sup);
 
   if (qargs.cutoff > 0 && qargs.cutoff < input->size(0)) {
-    auto idx = selectEmbeddings(qargs.cutoff);
-    dict_->prune(idx);
-    std::shared_ptr<DenseMatrix> ninput =
-        std::make_shared<DenseMatrix>(idx.size(), args_->dim);
-    for (auto i = 0; i < idx.size(); i++) {
-      for (auto j = 0; j < args_->dim; j++) {
-        ninput->at(i, j) = input->at(idx[i], j);
-      }
+    if (qargs.retrain && Corpus::isCorpus(args_->input)) {
+      throw std::invalid_argument(
+          "Retraining a pruned model needs the text training file!");
+    }
+    if (corpus_) {
+      // the dictionary may be shared with the corpus, and pruning changes
+      // the ids its records were tokenized with
+      dict_ = std::make_shared<Dictionary>(*dict_);
+      corpus_.reset();
     }
-    input = ninput;
+    auto idx = selectEmbeddings(qargs.cutoff, qargs.thread);
+    dict_->prune(idx);
+    // input_ is replaced below, so the kept rows are moved within input
+    // rather than copied to a second matrix, and the memory of the others is
+    // released with it
+    input->compactRows(idx);
     if (qargs.retrain) {
       args_->epoch = qargs.epoch;
       args_->lr = qargs.lr;
       args_->thread = qargs.thread;
       args_->verbose = qargs.verbose;
+      epochTokens_ = dict_->ntokens();
       auto loss = createLoss(output_);
       model_ = std::make_shared<Model>(input, output, loss, normalizeGradient);
       startThreads(callback);
     }
   }
-  input_ = std::make_shared<QuantMatrix>(
-      std::move(*(input.get())), qargs.dsub, qargs.qnorm);
-
-  if (args_->qout) {
-    output_ = std::make_shared<QuantMatrix>(
-        std::move(*(output.get())), 2, qargs.qnorm);
+  if (!qargs.half.empty()) {
+    input_ = std::make_shared<HalfMatrix>(*input, qargs.half == "bf16");
+    if (args_->qout) {
+      output_ = std::make_shared<HalfMatrix>(*output, qargs.half == "bf16");
+    }
+  } else if (qargs.int8) {
+    input_ = std::make_shared<Int8Matrix>(*input);
+    if (args_->qout) {
+      output_ = std::make_shared<Int8Matrix>(*output);
+    }
+  } else {
+    input_ = std::make_shared<QuantMatrix>(
+        std::move(*(input.get())),
+        qargs.dsub,
+        qargs.qnorm,
+        qargs.thread,
+        qargs.nbits,
+        qargs.opq);
+
+    if (args_->qout) {
+      output_ = std::make_shared<QuantMatrix>(
+          std::move(*(output.get())),
+          2,
+          qargs.qnorm,
+          qargs.thread,
+          qargs.nbits);
+    }
   }
   quant_ = true;
   auto loss = createLoss(output_);
@@ -395,8 +1016,8 @@ void FastText::cbow(
     bow.clear();
     for (int32_t c = -boundary; c <= boundary; c++) {
       if (c != 0 && w + c >= 0 && w + c < line.size()) {
-        const std::vector<int32_t>& ngrams = dict_->getSubwords(line[w + c]);
-        bow.insert(bow.end(), ngrams.cbegin(), ngrams.cend());
+        Span<const int32_t> ngrams = dict_->getSubwords(line[w + c]);
+        bow.insert(bow.end(), ngrams.begin(), ngrams.end());
       }
     }
     model_->update(bow, line, w, lr, state);
@@ -410,7 +1031,7 @@ void FastText::skipgram(
   std::uniform_int_distribution<> uniform(1, args_->ws);
   for (int32_t w = 0; w < line.size(); w++) {
     int32_t boundary = uniform(state.rng);
-    const std::vector<int32_t>& ngrams = dict_->getSubwords(line[w]);
+    Span<const int32_t> ngrams = dict_->getSubwords(line[w]);
     for (int32_t c = -boundary; c <= boundary; c++) {
       if (c != 0 && w + c >= 0 && w + c < line.size()) {
         model_->update(ngrams, line, w + c, lr, state);
@@ -450,6 +1071,30 @@ void FastText::test(std::istream& in, int32_t k, real threshold, Meter& meter)
   }
 }
 
+void FastText::test(
+    const Corpus& corpus,
+    int32_t k,
+    real threshold,
+    Meter& meter) const {
+  if (corpus.nrecords() == 0) {
+    return;
+  }
+  std::vector<int32_t> line;
+  std::vector<int32_t> labels;
+  Predictions predictions;
+  Corpus::Reader reader(corpus, 0);
+
+  for (int64_t i = 0; i < corpus.nrecords(); i++) {
+    dict_->getLine(reader.next(), line, labels);
+
+    if (!labels.empty() && !line.empty()) {
+      predictions.clear();
+      predict(k, line, predictions, threshold);
+      meter.log(labels, predictions);
+    }
+  }
+}
+
 void FastText::predict(
     int32_t k,
     const std::vector<int32_t>& words,
@@ -492,11 +1137,8 @@ void FastText::getSentenceVector(std::istream& in, fasttext::Vector& svec) {
   if (args_->model == model_name::sup) {
     std::vector<int32_t> line, labels;
     dict_->getLine(in, line, labels);
-    for (int32_t i = 0; i < line.size(); i++) {
-      addInputVector(svec, line[i]);
-    }
     if (!line.empty()) {
-      svec.mul(1.0 / line.size());
+      input_->averageRowsToVector(svec, line);
     }
   } else {
     Vector vec(args_->dim);
@@ -538,16 +1180,20 @@ std::vector<std::pair<std::string, Vector>> FastText::getNgramVectors(
 }
 
 void FastText::precomputeWordVectors(DenseMatrix& wordVectors) {
-  Vector vec(args_->dim);
   wordVectors.zero();
-  for (int32_t i = 0; i < dict_->nwords(); i++) {
-    std::string word = dict_->getWord(i);
-    getWordVector(vec, word);
-    real norm = vec.norm();
-    if (norm > 0) {
-      wordVectors.addVectorToRow(vec, i, 1.0 / norm);
-    }
-  }
+  utils::parallelFor(
+      dict_->nwords(),
+      std::max(args_->thread, 1),
+      [&](int64_t begin, int64_t end) {
+        Vector vec(args_->dim);
+        for (auto i = begin; i < end; i++) {
+          getWordVector(vec, i);
+          real norm = vec.norm();
+          if (norm > 0) {
+            wordVectors.addVectorToRow(vec, i, 1.0 / norm);
+          }
+        }
+      });
 }
 
 void FastText::lazyComputeWordVectors() {
@@ -630,16 +1276,22 @@ bool FastText::keepTraining(const int64_t ntokens) const {
 }
 
 void FastText::trainThread(int32_t threadId, const TrainCallback& callback) {
-  std::ifstream ifs(args_->input);
-  utils::seek(ifs, threadId * utils::size(ifs) / args_->thread);
-
+  std::ifstream ifs;
+  std::unique_ptr<Corpus::Reader> reader;
   Model::State state(args_->dim, output_->size(0), threadId + args_->seed);
 
-  const int64_t ntokens = dict_->ntokens();
+  const int64_t ntokens = epochTokens_;
   int64_t localTokenCount = 0;
   std::vector<int32_t> line, labels;
   uint64_t callbackCounter = 0;
   try {
+    if (corpus_) {
+      reader = std::unique_ptr<Corpus::Reader>(new Corpus::Reader(
+          *corpus_, threadId * corpus_->nrecords() / args_->thread));
+    } else {
+      ifs.open(args_->input);
+      utils::seek(ifs, threadId * utils::size(ifs) / args_->thread);
+    }
     while (keepTraining(ntokens)) {
       real progress = real(tokenCount_) / (args_->epoch * ntokens);
       if (callback && ((callbackCounter++ % 64) == 0)) {
@@ -652,14 +1304,19 @@ void FastText::trainThread(int32_t threadId, const TrainCallback& callback) {
       }
       real lr = args_->lr * (1.0 - progress);
       if (args_->model == model_name::sup) {
-        localTokenCount += dict_->getLine(ifs, line, labels);
+        localTokenCount += reader
+            ? dict_->getLine(reader->next(), line, labels)
+            : dict_->getLine(ifs, line, labels);
         supervised(state, lr, line, labels);
-      } else if (args_->model == model_name::cbow) {
-        localTokenCount += dict_->getLine(ifs, line, state.rng);
-        cbow(state, lr, line);
-      } else if (args_->model == model_name::sg) {
-        localTokenCount += dict_->getLine(ifs, line, state.rng);
-        skipgram(state, lr, line);
+      } else {
+        localTokenCount += reader
+            ? dict_->getLine(reader->next(), line, state.rng)
+            : dict_->getLine(ifs, line, state.rng);
+        if (args_->model == model_name::cbow) {
+          cbow(state, lr, line);
+        } else if (args_->model == model_name::sg) {
+          skipgram(state, lr, line);
+        }
       }
       if (localTokenCount > args_->lrUpdateRate) {
         tokenCount_ += localTokenCount;
@@ -671,6 +1328,9 @@ void FastText::trainThread(int32_t threadId, const TrainCallback& callback) {
     }
   } catch (DenseMatrix::EncounteredNaNError&) {
     trainException_ = std::current_exception();
+  } catch (std::invalid_argument&) {
+    // a corrupted preprocessed corpus
+    trainException_ = std::current_exception();
   }
   if (threadId == 0)
     loss_ = state.getLoss();
@@ -679,30 +1339,12 @@ void FastText::trainThread(int32_t threadId, const TrainCallback& callback) {
 
 std::shared_ptr<Matrix> FastText::getInputMatrixFromFile(
     const std::string& filename) const {
-  std::ifstream in(filename);
-  std::vector<std::string> words;
-  std::shared_ptr<DenseMatrix> mat; // temp. matrix for pretrained vectors
-  int64_t n, dim;
-  if (!in.is_open()) {
-    throw std::invalid_argument(filename + " cannot be opened for loading!");
-  }
-  in >> n >> dim;
-  if (dim != args_->dim) {
-    throw std::invalid_argument(
-        "Dimension of pretrained vectors (" + std::to_string(dim) +
-        ") does not match dimension (" + std::to_string(args_->dim) + ")!");
-  }
-  mat = std::make_shared<DenseMatrix>(n, dim);
-  for (size_t i = 0; i < n; i++) {
-    std::string word;
-    in >> word;
-    words.push_back(word);
+  WordVectors vectors(filename, args_->dim, args_->thread);
+  const std::vector<std::string>& words = vectors.getWords();
+  std::shared_ptr<const DenseMatrix> mat = vectors.getMatrix();
+  for (const auto& word : words) {
     dict_->add(word);
-    for (size_t j = 0; j < dim; j++) {
-      in >> mat->at(i, j);
-    }
   }
-  in.close();
 
   dict_->threshold(1, 0);
   dict_->init();
@@ -710,14 +1352,13 @@ std::shared_ptr<Matrix> FastText::getInputMatrixFromFile(
       dict_->nwords() + args_->bucket, args_->dim);
   input->uniform(1.0 / args_->dim, args_->thread, args_->seed);
 
-  for (size_t i = 0; i < n; i++) {
+  for (size_t i = 0; i < words.size(); i++) {
     int32_t idx = dict_->getId(words[i]);
     if (idx < 0 || idx >= dict_->nwords()) {
       continue;
     }
-    for (size_t j = 0; j < dim; j++) {
-      input->at(idx, j) = mat->at(i, j);
-    }
+    const real* row = mat->data() + i * args_->dim;
+    std::copy(row, row + args_->dim, input->data() + int64_t(idx) * args_->dim);
   }
   return input;
 }
@@ -747,6 +1388,25 @@ void FastText::train(const Args& args, const TrainCallback& callback) {
     // manage expectations
     throw std::invalid_argument("Cannot use stdin for training!");
   }
+  if (Corpus::isCorpus(args_->input)) {
+    train(args, std::make_shared<Corpus>(args_->input, args_), callback);
+    return;
+  }
+  corpus_.reset();
+  if (!args_->resume.empty()) {
+    int64_t tokenCount = loadCheckpoint(args_->resume);
+    quant_ = false;
+    buildModel();
+    startThreads(callback, tokenCount);
+    return;
+  }
+  if (!args_->inputModel.empty()) {
+    loadInputModel(args_->inputModel);
+    quant_ = false;
+    buildModel();
+    startThreads(callback);
+    return;
+  }
   std::ifstream ifs(args_->input);
   if (!ifs.is_open()) {
     throw std::invalid_argument(
@@ -760,6 +1420,54 @@ void FastText::train(const Args& args, const TrainCallback& callback) {
   } else {
     input_ = createRandomMatrix();
   }
+  trainModel(callback);
+}
+
+void FastText::train(
+    const Args& args,
+    const std::shared_ptr<Corpus>& corpus,
+    const TrainCallback& callback) {
+  args_ = std::make_shared<Args>(args);
+  if (!args_->pretrainedVectors.empty()) {
+    // pretrained vectors add words to the dictionary, changing the ids the
+    // corpus was tokenized with
+    throw std::invalid_argument(
+        "Pretrained vectors cannot be used with a preprocessed corpus!");
+  }
+  if (!args_->inputModel.empty() && args_->resume.empty()) {
+    throw std::invalid_argument(
+        "An input model cannot be trained further on a preprocessed corpus!");
+  }
+  corpus_ = corpus;
+  if (!args_->resume.empty()) {
+    int64_t tokenCount = loadCheckpoint(args_->resume);
+    // the records of the corpus are ids of its own dictionary
+    std::shared_ptr<Dictionary> dict = corpus_->getDictionary();
+    if (dict_->nwords() != dict->nwords() ||
+        dict_->nlabels() != dict->nlabels() ||
+        dict_->ntokens() != dict->ntokens()) {
+      throw std::invalid_argument(
+          args_->resume + " was not trained on this corpus!");
+    }
+    dict_ = dict;
+    quant_ = false;
+    buildModel();
+    startThreads(callback, tokenCount);
+    return;
+  }
+  dict_ = corpus_->getDictionary();
+  if (args_->verbose > 0) {
+    std::cerr << "Read " << dict_->ntokens() / 1000000 << "M words"
+              << std::endl;
+    std::cerr << "Number of words:  " << dict_->nwords() << std::endl;
+    std::cerr << "Number of labels: " << dict_->nlabels() << std::endl;
+  }
+  input_ = createRandomMatrix();
+  trainModel(callback);
+}
+
+void FastText::trainModel(const TrainCallback& callback) {
+  epochTokens_ = dict_->ntokens();
   output_ = createTrainOutputMatrix();
   quant_ = false;
   auto loss = createLoss(output_);
@@ -776,13 +1484,19 @@ void FastText::abort() {
   }
 }
 
-void FastText::startThreads(const TrainCallback& callback) {
+void FastText::startThreads(
+    const TrainCallback& callback,
+    int64_t tokenCount) {
   start_ = std::chrono::steady_clock::now();
-  tokenCount_ = 0;
+  tokenCount_ = tokenCount;
+  startTokenCount_ = tokenCount;
   loss_ = -1;
   trainException_ = nullptr;
+  // Checkpoints are saved by this thread while the workers keep training, so
+  // they need their own threads even when there is only one.
+  const bool checkpoint = !args_->checkpoint.empty();
   std::vector<std::thread> threads;
-  if (args_->thread > 1) {
+  if (args_->thread > 1 || checkpoint) {
     for (int32_t i = 0; i < args_->thread; i++) {
       threads.push_back(std::thread([=]() { trainThread(i, callback); }));
     }
@@ -790,7 +1504,9 @@ void FastText::startThreads(const TrainCallback& callback) {
     // webassembly can't instantiate `std::thread`
     trainThread(0, callback);
   }
-  const int64_t ntokens = dict_->ntokens();
+  const int64_t ntokens = epochTokens_;
+  auto lastCheckpoint = start_;
+  int64_t lastCheckpointTokenCount = tokenCount;
   // Same condition as trainThread
   while (keepTraining(ntokens)) {
     std::this_thread::sleep_for(std::chrono::milliseconds(100));
@@ -799,6 +1515,26 @@ void FastText::startThreads(const TrainCallback& callback) {
       std::cerr << "\r";
       printInfo(progress, loss_, std::cerr);
     }
+    if (!checkpoint) {
+      continue;
+    }
+    auto now = std::chrono::steady_clock::now();
+    int64_t tokens = tokenCount_;
+    if ((args_->checkpointInterval > 0 &&
+         utils::getDuration(lastCheckpoint, now) >=
+             args_->checkpointInterval * 60.0) ||
+        (args_->checkpointTokens > 0 &&
+         tokens - lastCheckpointTokenCount >= args_->checkpointTokens)) {
+      // The matrices are saved as the workers update them, like they read
+      // them, and tokens is the count when the saving started.
+      try {
+        saveCheckpoint(args_->checkpoint, tokens);
+      } catch (...) {
+        trainException_ = std::current_exception();
+      }
+      lastCheckpoint = std::chrono::steady_clock::now();
+      lastCheckpointTokenCount = tokens;
+    }
   }
   for (int32_t i = 0; i < threads.size(); i++) {
     threads[i].join();
@@ -20,6 +20,7 @@
 #include <tuple>
 
 #include "args.h"
+#include "corpus.h"
 #include "densematrix.h"
 #include "dictionary.h"
 #include "matrix.h"
@@ -39,20 +40,47 @@ class FastText {
  protected:
   std::shared_ptr<Args> args_;
   std::shared_ptr<Dictionary> dict_;
+  std::shared_ptr<Corpus> corpus_;
   std::shared_ptr<Matrix> input_;
   std::shared_ptr<Matrix> output_;
   std::shared_ptr<Model> model_;
   std::atomic<int64_t> tokenCount_{};
+  int64_t startTokenCount_{};
+  // number of tokens in the training data, which is less than the dictionary
+  // counts when a model is trained further on new data
+  int64_t epochTokens_{};
   std::atomic<real> loss_{};
   std::chrono::steady_clock::time_point start_;
   bool quant_;
   int32_t version;
   std::unique_ptr<DenseMatrix> wordVectors_;
   std::exception_ptr trainException_;
+  // seconds spent on each part of the last load, in the order they finished
+  std::vector<std::pair<std::string, double>> loadTimes_;
 
   void signModel(std::ostream&);
   bool checkModel(std::istream&);
-  void startThreads(const TrainCallback& callback = {});
+  void startThreads(
+      const TrainCallback& callback = {},
+      int64_t tokenCount = 0);
+  void saveCheckpoint(const std::string& filename, int64_t tokenCount);
+  void loadSections(
+      std::istream& in,
+      const std::string& half,
+      int32_t thread = 1);
+  void loadUnindexedSections(
+      std::istream& in,
+      const std::string& half,
+      int32_t thread);
+  void loadSection(std::istream& in, uint32_t id, const std::string& half);
+  void loadCompressedSection(
+      std::istream& in,
+      uint32_t id,
+      const std::string& half,
+      int32_t thread);
+  void loadTrainableModel(std::istream& in, const std::string& name);
+  int64_t loadCheckpoint(const std::string& filename);
+  void loadInputModel(const std::string& filename);
   void addInputVector(Vector&, int32_t) const;
   void trainThread(int32_t, const TrainCallback& callback);
   std::vector<std::pair<real, std::string>> getNN(
@@ -65,6 +93,7 @@ class FastText {
   std::shared_ptr<Matrix> getInputMatrixFromFile(const std::string&) const;
   std::shared_ptr<Matrix> createRandomMatrix() const;
   std::shared_ptr<Matrix> createTrainOutputMatrix() const;
+  void trainModel(const TrainCallback& callback);
   std::vector<int64_t> getTargetCounts() const;
   std::shared_ptr<Loss> createLoss(std::shared_ptr<Matrix>& output);
   void supervised(
@@ -74,7 +103,8 @@ class FastText {
       const std::vector<int32_t>& labels);
   void cbow(Model::State& state, real lr, const std::vector<int32_t>& line);
   void skipgram(Model::State& state, real lr, const std::vector<int32_t>& line);
-  std::vector<int32_t> selectEmbeddings(int32_t cutoff) const;
+  std::vector<int32_t> selectEmbeddings(int32_t cutoff, int32_t thread = 1)
+      const;
   void precomputeWordVectors(DenseMatrix& wordVectors);
   bool keepTraining(const int64_t ntokens) const;
   void buildModel();
@@ -91,6 +121,8 @@ class FastText {
 
   void getWordVector(Vector& vec, const std::string& word) const;
 
+  void getWordVector(Vector& vec, int32_t wordId) const;
+
   void getSubwordVector(Vector& vec, const std::string& subword) const;
 
   inline void getInputVector(Vector& vec, int32_t ind) {
@@ -110,15 +142,34 @@ class FastText {
 
   std::shared_ptr<const DenseMatrix> getOutputMatrix() const;
 
-  void saveVectors(const std::string& filename);
+  void saveVectors(const std::string& filename, bool binary = false);
+
+  // With compress, the dictionary and the matrices are compressed in blocks,
+  // args.thread at a time.
+  void saveModel(std::ostream& out, bool compress = false);
 
-  void saveModel(const std::string& filename);
+  void saveModel(const std::string& filename, bool compress = false);
 
   void saveOutput(const std::string& filename);
 
-  void loadModel(std::istream& in);
+  // half ("fp16" or "bf16") stores the dense matrices of the model in half
+  // precision, converting them as they are read. With more than one thread,
+  // the index of a dictionary saved without it is rebuilt while the matrices
+  // are read.
+  void loadModel(
+      std::istream& in,
+      const std::string& half = "",
+      int32_t thread = 1);
+
+  void loadModel(
+      const std::string& filename,
+      const std::string& half = "",
+      int32_t thread = 1);
+
+  const std::vector<std::pair<std::string, double>>& getLoadTimes() const;
 
-  void loadModel(const std::string& filename);
+  // Reads the arguments and the dictionary of a model, without its matrices.
+  void loadDictionary(const std::string& filename);
 
   void getSentenceVector(std::istream& in, Vector& vec);
 
@@ -129,6 +180,10 @@ class FastText {
 
   void test(std::istream& in, int32_t k, real threshold, Meter& meter) const;
 
+  // The corpus must have been tokenized with the dictionary of this model.
+  void test(const Corpus& corpus, int32_t k, real threshold, Meter& meter)
+      const;
+
   void predict(
       int32_t k,
       const std::vector<int32_t>& words,
@@ -156,6 +211,11 @@ class FastText {
 
   void train(const Args& args, const TrainCallback& callback = {});
 
+  void train(
+      const Args& args,
+      const std::shared_ptr<Corpus>& corpus,
+      const TrainCallback& callback = {});
+
   void abort();
 
   int getDimension() const;
@@ -0,0 +1,269 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "halfmatrix.h"
+
+#include <assert.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include "simd.h"
+
+namespace fasttext {
+
+float halfToFloat(uint16_t h) {
+  uint32_t sign = uint32_t(h & 0x8000) << 16;
+  uint32_t exponent = (h >> 10) & 0x1f;
+  uint32_t mantissa = h & 0x3ff;
+  uint32_t bits;
+  if (exponent == 0) {
+    // zero or subnormal, which is exactly mantissa * 2^-24
+    float f = std::ldexp(float(mantissa), -24);
+    return sign ? -f : f;
+  } else if (exponent == 0x1f) {
+    bits = sign | 0x7f800000 | (mantissa << 13);
+  } else {
+    bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+  }
+  float f;
+  std::memcpy(&f, &bits, sizeof(float));
+  return f;
+}
+
+// Rounds to the nearest half precision value, ties to even.
+uint16_t floatToHalf(float f) {
+  uint32_t bits;
+  std::memcpy(&bits, &f, sizeof(float));
+  uint16_t sign = (bits >> 16) & 0x8000;
+  bits &= 0x7fffffff;
+  if (bits > 0x7f800000) {
+    return sign | 0x7e00;
+  }
+  if (bits >= 0x477ff000) {
+    // 65520 and above round to infinity
+    return sign | 0x7c00;
+  }
+  if (bits < 0x38800000) {
+    // below 2^-14 the result is subnormal, and f * 2^24 is exact
+    std::memcpy(&f, &bits, sizeof(float));
+    return sign | uint16_t(std::nearbyint(f * 16777216.0f));
+  }
+  bits += 0xfff + ((bits >> 13) & 1) - 0x38000000;
+  return sign | uint16_t(bits >> 13);
+}
+
+float bfloat16ToFloat(uint16_t h) {
+  uint32_t bits = uint32_t(h) << 16;
+  float f;
+  std::memcpy(&f, &bits, sizeof(float));
+  return f;
+}
+
+// Rounds to the nearest bfloat16 value, ties to even.
+uint16_t floatToBFloat16(float f) {
+  uint32_t bits;
+  std::memcpy(&bits, &f, sizeof(float));
+  if ((bits & 0x7fffffff) > 0x7f800000) {
+    return (bits >> 16) | 0x40;
+  }
+  bits += 0x7fff + ((bits >> 16) & 1);
+  return bits >> 16;
+}
+
+template <bool BFloat16>
+inline real toFloat(uint16_t h) {
+  return BFloat16 ? bfloat16ToFloat(h) : halfToFloat(h);
+}
+
+/* Converts sizeof(Register) / sizeof(float) values to float. bf16 values only
+ * need to be shifted to the upper half of each lane, fp16 values use the F16C
+ * conversion. */
+#if defined(__AVX512F__)
+template <bool BFloat16>
+inline Register LoadHalf(const uint16_t* from) {
+  __m256i h = _mm256_loadu_si256((const __m256i*)from);
+  if (BFloat16) {
+    return _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_cvtepu16_epi32(h), 16));
+  }
+  return _mm512_cvtph_ps(h);
+}
+#elif defined(__AVX2__) && defined(__F16C__)
+template <bool BFloat16>
+inline Register LoadHalf(const uint16_t* from) {
+  __m128i h = _mm_loadu_si128((const __m128i*)from);
+  if (BFloat16) {
+    return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(h), 16));
+  }
+  return _mm256_cvtph_ps(h);
+}
+#endif
+
+template <bool BFloat16>
+real dotHalf(const uint16_t* row, const real* vec, int64_t n) {
+  int64_t j = 0;
+  real d = 0.0;
+#if defined(__AVX512F__) || (defined(__AVX2__) && defined(__F16C__))
+  constexpr int64_t kWidth = sizeof(Register) / sizeof(real);
+  Register sum = Set1(0.0);
+  for (; j + kWidth <= n; j += kWidth) {
+    sum = Add(sum, Multiply(LoadHalf<BFloat16>(row + j), LoadU(vec + j)));
+  }
+  real lanes[kWidth];
+  StoreU(lanes, sum);
+  for (int64_t k = 0; k < kWidth; k++) {
+    d += lanes[k];
+  }
+#endif
+  for (; j < n; j++) {
+    d += toFloat<BFloat16>(row[j]) * vec[j];
+  }
+  return d;
+}
+
+// x[j] += a * row[j]
+template <bool BFloat16>
+void addHalf(real* x, const uint16_t* row, real a, int64_t n) {
+  int64_t j = 0;
+#if defined(__AVX512F__) || (defined(__AVX2__) && defined(__F16C__))
+  constexpr int64_t kWidth = sizeof(Register) / sizeof(real);
+  const Register scale = Set1(a);
+  for (; j + kWidth <= n; j += kWidth) {
+    StoreU(
+        x + j,
+        Add(LoadU(x + j), Multiply(scale, LoadHalf<BFloat16>(row + j))));
+  }
+#endif
+  for (; j < n; j++) {
+    x[j] += a * toFloat<BFloat16>(row[j]);
+  }
+}
+
+HalfMatrix::HalfMatrix(bool bfloat16) : Matrix(), bfloat16_(bfloat16) {}
+
+HalfMatrix::HalfMatrix(const DenseMatrix& mat, bool bfloat16)
+    : Matrix(mat.size(0), mat.size(1)), data_(m_ * n_), bfloat16_(bfloat16) {
+  fromFloat(mat.data(), data_.data(), m_ * n_);
+}
+
+void HalfMatrix::fromFloat(const real* x, uint16_t* h, int64_t n) const {
+  int64_t j = 0;
+  if (bfloat16_) {
+    for (; j < n; j++) {
+      h[j] = floatToBFloat16(x[j]);
+    }
+    return;
+  }
+#if defined(__F16C__)
+  for (; j + 8 <= n; j += 8) {
+    _mm_storeu_si128(
+        (__m128i*)(h + j),
+        _mm256_cvtps_ph(_mm256_loadu_ps(x + j), _MM_FROUND_TO_NEAREST_INT));
+  }
+#endif
+  for (; j < n; j++) {
+    h[j] = floatToHalf(x[j]);
+  }
+}
+
+bool HalfMatrix::isBFloat16() const {
+  return bfloat16_;
+}
+
+real HalfMatrix::dotRow(const Vector& vec, int64_t i) const {
+  assert(i >= 0);
+  assert(i < m_);
+  assert(vec.size() == n_);
+  const uint16_t* row = data_.data() + i * n_;
+  real d = bfloat16_ ? dotHalf<true>(row, vec.data(), n_)
+                     : dotHalf<false>(row, vec.data(), n_);
+  if (std::isnan(d)) {
+    throw DenseMatrix::EncounteredNaNError();
+  }
+  return d;
+}
+
+void HalfMatrix::addVectorToRow(const Vector&, int64_t, real) {
+  throw std::runtime_error(
+      "Operation not permitted on half precision matrices.");
+}
+
+void HalfMatrix::addRowToVector(Vector& x, int32_t i) const {
+  addRowToVector(x, i, 1.0);
+}
+
+void HalfMatrix::addRowToVector(Vector& x, int32_t i, real a) const {
+  assert(i >= 0);
+  assert(i < m_);
+  assert(x.size() == n_);
+  const uint16_t* row = data_.data() + i * n_;
+  if (bfloat16_) {
+    addHalf<true>(x.data(), row, a, n_);
+  } else {
+    addHalf<false>(x.data(), row, a, n_);
+  }
+}
+
+void HalfMatrix::averageRowsToVector(Vector& x, Span<const int32_t> rows) const {
+  x.zero();
+  for (auto it = rows.begin(); it != rows.end(); ++it) {
+    addRowToVector(x, *it);
+  }
+  x.mul(1.0 / rows.size());
+}
+
+void HalfMatrix::save(std::ostream& out) const {
+  uint8_t format = bfloat16_;
+  out.write((char*)&format, sizeof(format));
+  out.write((char*)&m_, sizeof(m_));
+  out.write((char*)&n_, sizeof(n_));
+  out.write((char*)data_.data(), m_ * n_ * sizeof(uint16_t));
+}
+
+void HalfMatrix::load(std::istream& in) {
+  uint8_t format;
+  in.read((char*)&format, sizeof(format));
+  if (format > 1) {
+    throw std::invalid_argument("Unsupported half precision matrix format!");
+  }
+  bfloat16_ = format;
+  in.read((char*)&m_, sizeof(m_));
+  in.read((char*)&n_, sizeof(n_));
+  data_ = std::vector<uint16_t>(m_ * n_);
+  in.read((char*)data_.data(), m_ * n_ * sizeof(uint16_t));
+}
+
+void HalfMatrix::loadDense(std::istream& in) {
+  in.read((char*)&m_, sizeof(m_));
+  in.read((char*)&n_, sizeof(n_));
+  data_ = std::vector<uint16_t>(m_ * n_);
+  const int64_t rows = std::max<int64_t>(1, (1 << 16) / std::max<int64_t>(n_, 1));
+  std::vector<real> buffer(rows * n_);
+  for (int64_t i = 0; i < m_; i += rows) {
+    int64_t count = std::min(rows, m_ - i) * n_;
+    in.read((char*)buffer.data(), count * sizeof(real));
+    fromFloat(buffer.data(), data_.data() + i * n_, count);
+  }
+}
+
+void HalfMatrix::dump(std::ostream& out) const {
+  out << m_ << " " << n_ << std::endl;
+  for (int64_t i = 0; i < m_; i++) {
+    for (int64_t j = 0; j < n_; j++) {
+      if (j > 0) {
+        out << " ";
+      }
+      uint16_t h = data_[i * n_ + j];
+      out << (bfloat16_ ? bfloat16ToFloat(h) : halfToFloat(h));
+    }
+    out << std::endl;
+  }
+}
+
+} // namespace fasttext
@@ -0,0 +1,60 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+#include "densematrix.h"
+#include "matrix.h"
+#include "real.h"
+#include "vector.h"
+
+namespace fasttext {
+
+/**
+ * A matrix stored with 16 bits per value, either as IEEE half precision
+ * floats (fp16) or as the upper half of single precision floats (bf16).
+ * Rows are converted back to float when they are read.
+ */
+class HalfMatrix : public Matrix {
+ protected:
+  std::vector<uint16_t> data_;
+  bool bfloat16_;
+
+  void fromFloat(const real*, uint16_t*, int64_t) const;
+
+ public:
+  explicit HalfMatrix(bool bfloat16 = false);
+  HalfMatrix(const DenseMatrix&, bool bfloat16);
+  HalfMatrix(const HalfMatrix&) = delete;
+  HalfMatrix(HalfMatrix&&) = delete;
+  HalfMatrix& operator=(const HalfMatrix&) = delete;
+  HalfMatrix& operator=(HalfMatrix&&) = delete;
+  virtual ~HalfMatrix() noexcept override = default;
+
+  bool isBFloat16() const;
+
+  real dotRow(const Vector&, int64_t) const override;
+  void addVectorToRow(const Vector&, int64_t, real) override;
+  void addRowToVector(Vector& x, int32_t i) const override;
+  void addRowToVector(Vector& x, int32_t i, real a) const override;
+  void averageRowsToVector(Vector& x, Span<const int32_t> rows) const override;
+  void save(std::ostream&) const override;
+  void load(std::istream&) override;
+  void dump(std::ostream&) const override;
+
+  // Reads a matrix saved by DenseMatrix::save, converting it a few rows at a
+  // time so that the float values are never all held in memory.
+  void loadDense(std::istream&);
+};
+
+} // namespace fasttext
@@ -0,0 +1,196 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "int8matrix.h"
+
+#include <assert.h>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace fasttext {
+
+// Sum of a[j] * b[j], with products of pairs of int16 added into int32 lanes.
+int32_t dotInt8(const int8_t* a, const int8_t* b, int64_t n) {
+  int64_t j = 0;
+  int32_t dot = 0;
+#if defined(__AVX512BW__)
+  __m512i sum = _mm512_setzero_si512();
+  for (; j + 32 <= n; j += 32) {
+    __m512i va = _mm512_cvtepi8_epi16(_mm256_loadu_si256((const __m256i*)(a + j)));
+    __m512i vb = _mm512_cvtepi8_epi16(_mm256_loadu_si256((const __m256i*)(b + j)));
+    sum = _mm512_add_epi32(sum, _mm512_madd_epi16(va, vb));
+  }
+  dot = _mm512_reduce_add_epi32(sum);
+#elif defined(__AVX2__)
+  __m256i sum = _mm256_setzero_si256();
+  for (; j + 16 <= n; j += 16) {
+    __m256i va = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(a + j)));
+    __m256i vb = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(b + j)));
+    sum = _mm256_add_epi32(sum, _mm256_madd_epi16(va, vb));
+  }
+  __m128i half = _mm_add_epi32(
+      _mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+  half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+  half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)));
+  dot = _mm_cvtsi128_si32(half);
+#endif
+  for (; j < n; j++) {
+    dot += int32_t(a[j]) * int32_t(b[j]);
+  }
+  return dot;
+}
+
+// Sum of row[j] * x[j], on floats.
+real dotInt8Float(const int8_t* row, const real* x, int64_t n) {
+  int64_t j = 0;
+  real dot = 0.0;
+#if defined(__AVX512F__)
+  __m512 sum = _mm512_setzero_ps();
+  for (; j + 16 <= n; j += 16) {
+    __m512 v = _mm512_cvtepi32_ps(
+        _mm512_cvtepi8_epi32(_mm_loadu_si128((const __m128i*)(row + j))));
+    sum = _mm512_fmadd_ps(v, _mm512_loadu_ps(x + j), sum);
+  }
+  dot = _mm512_reduce_add_ps(sum);
+#elif defined(__AVX2__)
+  __m256 sum = _mm256_setzero_ps();
+  for (; j + 8 <= n; j += 8) {
+    __m256 v = _mm256_cvtepi32_ps(
+        _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i*)(row + j))));
+    sum = _mm256_add_ps(sum, _mm256_mul_ps(v, _mm256_loadu_ps(x + j)));
+  }
+  __m128 half = _mm_add_ps(
+      _mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+  half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+  half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+  dot = _mm_cvtss_f32(half);
+#endif
+  for (; j < n; j++) {
+    dot += row[j] * x[j];
+  }
+  return dot;
+}
+
+// x[j] += a * row[j]
+void addInt8(real* x, const int8_t* row, real a, int64_t n) {
+  int64_t j = 0;
+#if defined(__AVX512F__)
+  const __m512 scale = _mm512_set1_ps(a);
+  for (; j + 16 <= n; j += 16) {
+    __m512 v = _mm512_cvtepi32_ps(
+        _mm512_cvtepi8_epi32(_mm_loadu_si128((const __m128i*)(row + j))));
+    _mm512_storeu_ps(x + j, _mm512_fmadd_ps(scale, v, _mm512_loadu_ps(x + j)));
+  }
+#elif defined(__AVX2__)
+  const __m256 scale = _mm256_set1_ps(a);
+  for (; j + 8 <= n; j += 8) {
+    __m256 v = _mm256_cvtepi32_ps(
+        _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i*)(row + j))));
+    _mm256_storeu_ps(
+        x + j, _mm256_add_ps(_mm256_loadu_ps(x + j), _mm256_mul_ps(scale, v)));
+  }
+#endif
+  for (; j < n; j++) {
+    x[j] += a * row[j];
+  }
+}
+
+Int8Matrix::Int8Matrix() : Matrix() {}
+
+Int8Matrix::Int8Matrix(const DenseMatrix& mat)
+    : Matrix(mat.size(0), mat.size(1)), data_(m_ * n_), scales_(m_) {
+  for (int64_t i = 0; i < m_; i++) {
+    scales_[i] = quantizeRow(mat.data() + i * n_, data_.data() + i * n_, n_);
+  }
+}
+
+// Writes the int8 values of x to q and returns the scale to multiply them
+// by to get x back.
+real Int8Matrix::quantizeRow(const real* x, int8_t* q, int64_t n) {
+  real max = 0.0;
+  for (int64_t j = 0; j < n; j++) {
+    max = std::max(max, std::abs(x[j]));
+  }
+  if (max == 0.0) {
+    std::fill(q, q + n, 0);
+    return 0.0;
+  }
+  real inverse = 127.0 / max;
+  for (int64_t j = 0; j < n; j++) {
+    q[j] = (int8_t)std::lround(x[j] * inverse);
+  }
+  return max / 127.0;
+}
+
+real Int8Matrix::dotRow(const Vector& vec, int64_t i) const {
+  assert(i >= 0);
+  assert(i < m_);
+  assert(vec.size() == n_);
+  // quantizing vec would cost more than the product for a single row
+  return dotInt8Float(data_.data() + i * n_, vec.data(), n_) * scales_[i];
+}
+
+void Int8Matrix::dotRowsToVector(Vector& x, const Vector& vec) const {
+  assert(x.size() == m_);
+  assert(vec.size() == n_);
+  std::vector<int8_t> q(n_);
+  real scale = quantizeRow(vec.data(), q.data(), n_);
+  for (int64_t i = 0; i < m_; i++) {
+    x[i] = dotInt8(data_.data() + i * n_, q.data(), n_) * scales_[i] * scale;
+  }
+}
+
+void Int8Matrix::addVectorToRow(const Vector&, int64_t, real) {
+  throw std::runtime_error("Operation not permitted on quantized matrices.");
+}
+
+void Int8Matrix::addRowToVector(Vector& x, int32_t i) const {
+  addRowToVector(x, i, 1.0);
+}
+
+void Int8Matrix::addRowToVector(Vector& x, int32_t i, real a) const {
+  assert(i >= 0);
+  assert(i < m_);
+  assert(x.size() == n_);
+  addInt8(x.data(), data_.data() + i * n_, a * scales_[i], n_);
+}
+
+void Int8Matrix::averageRowsToVector(Vector& x, Span<const int32_t> rows) const {
+  x.zero();
+  for (auto it = rows.begin(); it != rows.end(); ++it) {
+    addInt8(x.data(), data_.data() + *it * n_, scales_[*it], n_);
+  }
+  x.mul(1.0 / rows.size());
+}
+
+void Int8Matrix::save(std::ostream& out) const {
+  out.write((char*)&m_, sizeof(m_));
+  out.write((char*)&n_, sizeof(n_));
+  out.write((char*)scales_.data(), m_ * sizeof(real));
+  out.write((char*)data_.data(), m_ * n_ * sizeof(int8_t));
+}
+
+void Int8Matrix::load(std::istream& in) {
+  in.read((char*)&m_, sizeof(m_));
+  in.read((char*)&n_, sizeof(n_));
+  scales_ = std::vector<real>(m_);
+  in.read((char*)scales_.data(), m_ * sizeof(real));
+  data_ = std::vector<int8_t>(m_ * n_);
+  in.read((char*)data_.data(), m_ * n_ * sizeof(int8_t));
+}
+
+void Int8Matrix::dump(std::ostream&) const {
+  throw std::runtime_error("Operation not permitted on quantized matrices.");
+}
+
+} // namespace fasttext
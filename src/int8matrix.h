@@ -0,0 +1,56 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+#include "densematrix.h"
+#include "matrix.h"
+#include "real.h"
+#include "vector.h"
+
+namespace fasttext {
+
+/**
+ * A matrix stored as one byte per value, each row being scaled so that its
+ * largest absolute value maps to 127. Vectors that are multiplied with all
+ * the rows are quantized the same way, and the products are computed on
+ * integers; single rows are multiplied with the vector as it is.
+ */
+class Int8Matrix : public Matrix {
+ protected:
+  std::vector<int8_t> data_;
+  std::vector<real> scales_;
+
+  static real quantizeRow(const real*, int8_t*, int64_t);
+
+ public:
+  Int8Matrix();
+  explicit Int8Matrix(const DenseMatrix&);
+  Int8Matrix(const Int8Matrix&) = delete;
+  Int8Matrix(Int8Matrix&&) = delete;
+  Int8Matrix& operator=(const Int8Matrix&) = delete;
+  Int8Matrix& operator=(Int8Matrix&&) = delete;
+  virtual ~Int8Matrix() noexcept override = default;
+
+  real dotRow(const Vector&, int64_t) const override;
+  void dotRowsToVector(Vector& x, const Vector& vec) const override;
+  void addVectorToRow(const Vector&, int64_t, real) override;
+  void addRowToVector(Vector& x, int32_t i) const override;
+  void addRowToVector(Vector& x, int32_t i, real a) const override;
+  void averageRowsToVector(Vector& x, Span<const int32_t> rows) const override;
+  void save(std::ostream&) const override;
+  void load(std::istream&) override;
+  void dump(std::ostream&) const override;
+};
+
+} // namespace fasttext
@@ -153,9 +153,10 @@ NegativeSamplingLoss::NegativeSamplingLoss(
   }
   for (size_t i = 0; i < targetCounts.size(); i++) {
     real c = pow(targetCounts[i], 0.5);
-    for (size_t j = 0; j < c * NegativeSamplingLoss::NEGATIVE_TABLE_SIZE / z;
-         j++) {
-      negatives_.push_back(i);
+    // i takes as many entries as there are integers below size
+    real size = c * NegativeSamplingLoss::NEGATIVE_TABLE_SIZE / z;
+    if (size > 0) {
+      negatives_.insert(negatives_.end(), size_t(std::ceil(size)), i);
     }
   }
   uniform_ = std::uniform_int_distribution<size_t>(0, negatives_.size() - 1);
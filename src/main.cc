@@ -6,16 +6,24 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <algorithm>
 #include <iomanip>
 #include <iostream>
 #include <queue>
 #include <stdexcept>
+#include <thread>
 #include "args.h"
 #include "autotune.h"
+#include "corpus.h"
 #include "fasttext.h"
 
 using namespace fasttext;
 
+// Models are loaded with one thread per core.
+int32_t getLoadThreads() {
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
 void printUsage() {
   std::cerr
       << "usage: fasttext <command> <args>\n\n"
@@ -23,6 +31,8 @@ void printUsage() {
       << "  supervised              train a supervised classifier\n"
       << "  quantize                quantize a model to reduce the memory "
          "usage\n"
+      << "  preprocess              tokenize a training file once for "
+         "repeated training\n"
       << "  test                    evaluate a supervised classifier\n"
       << "  test-label              print labels with precision and recall "
          "scores\n"
@@ -47,6 +57,14 @@ void printQuantizeUsage() {
   std::cerr << "usage: fasttext quantize <args>" << std::endl;
 }
 
+void printPreprocessUsage() {
+  std::cerr
+      << "usage: fasttext preprocess <supervised|skipgram|cbow> <args>\n\n"
+      << "  Writes <output>.ftc, which can be given as -input to the same\n"
+      << "  training command to skip reading and tokenizing the text.\n"
+      << std::endl;
+}
+
 void printTestUsage() {
   std::cerr
       << "usage: fasttext test <model> <test-data> [<k>] [<th>]\n\n"
@@ -106,9 +124,23 @@ void quantize(const std::vector<std::string>& args) {
   a.parseArgs(args);
   FastText fasttext;
   // parseArgs checks if a->output is given.
-  fasttext.loadModel(a.output + ".bin");
+  fasttext.loadModel(a.output + ".bin", "", a.thread);
   fasttext.quantize(a);
-  fasttext.saveModel(a.output + ".ftz");
+  fasttext.saveModel(a.output + ".ftz", a.compress);
+  exit(0);
+}
+
+void preprocess(const std::vector<std::string>& args) {
+  if (args.size() < 3 ||
+      (args[2] != "supervised" && args[2] != "skipgram" && args[2] != "cbow")) {
+    printPreprocessUsage();
+    exit(EXIT_FAILURE);
+  }
+  std::vector<std::string> trainArgs(args);
+  trainArgs.erase(trainArgs.begin() + 1);
+  auto a = std::make_shared<Args>();
+  a->parseArgs(trainArgs);
+  Corpus::preprocess(a, a->output + ".ftc");
   exit(0);
 }
 
@@ -129,7 +161,9 @@ void printAnalogiesUsage() {
 void printDumpUsage() {
   std::cout << "usage: fasttext dump <model> <option>\n\n"
             << "  <model>      model filename\n"
-            << "  <option>     option from args,dict,input,output" << std::endl;
+            << "  <option>     option from args,dict,input,output,load\n\n"
+            << "load prints the seconds spent on each part of loading the model"
+            << std::endl;
 }
 
 void test(const std::vector<std::string>& args) {
@@ -146,7 +180,7 @@ void test(const std::vector<std::string>& args) {
   real threshold = args.size() > 5 ? std::stof(args[5]) : 0.0;
 
   FastText fasttext;
-  fasttext.loadModel(model);
+  fasttext.loadModel(model, "", getLoadThreads());
 
   Meter meter(false);
 
@@ -225,7 +259,7 @@ void predict(const std::vector<std::string>& args) {
 
   bool printProb = args[1] == "predict-prob";
   FastText fasttext;
-  fasttext.loadModel(std::string(args[2]));
+  fasttext.loadModel(std::string(args[2]), "", getLoadThreads());
 
   std::ifstream ifs;
   std::string infile(args[3]);
@@ -255,7 +289,7 @@ void printWordVectors(const std::vector<std::string> args) {
     exit(EXIT_FAILURE);
   }
   FastText fasttext;
-  fasttext.loadModel(std::string(args[2]));
+  fasttext.loadModel(std::string(args[2]), "", getLoadThreads());
   std::string word;
   Vector vec(fasttext.getDimension());
   while (std::cin >> word) {
@@ -271,7 +305,7 @@ void printSentenceVectors(const std::vector<std::string> args) {
     exit(EXIT_FAILURE);
   }
   FastText fasttext;
-  fasttext.loadModel(std::string(args[2]));
+  fasttext.loadModel(std::string(args[2]), "", getLoadThreads());
   Vector svec(fasttext.getDimension());
   while (std::cin.peek() != EOF) {
     fasttext.getSentenceVector(std::cin, svec);
@@ -287,7 +321,7 @@ void printNgrams(const std::vector<std::string> args) {
     exit(EXIT_FAILURE);
   }
   FastText fasttext;
-  fasttext.loadModel(std::string(args[2]));
+  fasttext.loadModel(std::string(args[2]), "", getLoadThreads());
 
   std::string word(args[3]);
   std::vector<std::pair<std::string, Vector>> ngramVectors =
@@ -311,7 +345,7 @@ void nn(const std::vector<std::string> args) {
     exit(EXIT_FAILURE);
   }
   FastText fasttext;
-  fasttext.loadModel(std::string(args[2]));
+  fasttext.loadModel(std::string(args[2]), "", getLoadThreads());
   std::string prompt("Query word? ");
   std::cout << prompt;
 
@@ -339,7 +373,7 @@ void analogies(const std::vector<std::string> args) {
   FastText fasttext;
   std::string model(args[2]);
   std::cout << "Loading model " << model << std::endl;
-  fasttext.loadModel(model);
+  fasttext.loadModel(model, "", getLoadThreads());
 
   std::string prompt("Query triplet (A - B + C)? ");
   std::string wordA, wordB, wordC;
@@ -379,8 +413,12 @@ void train(const std::vector<std::string> args) {
   } else {
     fasttext->train(a);
   }
-  fasttext->saveModel(outputFileName);
-  fasttext->saveVectors(a.output + ".vec");
+  fasttext->saveModel(outputFileName, a.compress);
+  if (a.binaryVectors) {
+    fasttext->saveVectors(a.output + ".bvec", true);
+  } else {
+    fasttext->saveVectors(a.output + ".vec");
+  }
   if (a.saveOutput) {
     fasttext->saveOutput(a.output + ".output");
   }
@@ -396,7 +434,11 @@ void dump(const std::vector<std::string>& args) {
   std::string option = args[3];
 
   FastText fasttext;
-  fasttext.loadModel(modelPath);
+  if (option == "args" || option == "dict") {
+    fasttext.loadDictionary(modelPath);
+  } else {
+    fasttext.loadModel(modelPath, "", getLoadThreads());
+  }
   if (option == "args") {
     fasttext.getArgs().dump(std::cout);
   } else if (option == "dict") {
@@ -413,6 +455,10 @@ void dump(const std::vector<std::string>& args) {
     } else {
       fasttext.getOutputMatrix()->dump(std::cout);
     }
+  } else if (option == "load") {
+    for (const auto& time : fasttext.getLoadTimes()) {
+      std::cout << time.first << " " << time.second << std::endl;
+    }
   } else {
     printDumpUsage();
     exit(EXIT_FAILURE);
@@ -432,6 +478,8 @@ int main(int argc, char** argv) {
     test(args);
   } else if (command == "quantize") {
     quantize(args);
+  } else if (command == "preprocess") {
+    preprocess(args);
   } else if (command == "print-word-vectors") {
     printWordVectors(args);
   } else if (command == "print-sentence-vectors") {
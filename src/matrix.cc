@@ -8,6 +8,8 @@
 
 #include "matrix.h"
 
+#include "vector.h"
+
 namespace fasttext {
 
 Matrix::Matrix() : m_(0), n_(0) {}
@@ -22,4 +24,12 @@ int64_t Matrix::size(int64_t dim) const {
   return n_;
 }
 
+void Matrix::dotRowsToVector(Vector& x, const Vector& vec) const {
+  assert(x.size() == m_);
+  assert(vec.size() == n_);
+  for (int64_t i = 0; i < m_; i++) {
+    x[i] = dotRow(vec, i);
+  }
+}
+
 } // namespace fasttext
@@ -15,6 +15,7 @@
 
 #include <assert.h>
 #include "real.h"
+#include "span.h"
 
 namespace fasttext {
 
@@ -33,10 +34,11 @@ class Matrix {
   int64_t size(int64_t dim) const;
 
   virtual real dotRow(const Vector&, int64_t) const = 0;
+  virtual void dotRowsToVector(Vector& x, const Vector& vec) const;
   virtual void addVectorToRow(const Vector&, int64_t, real) = 0;
   virtual void addRowToVector(Vector& x, int32_t i) const = 0;
   virtual void addRowToVector(Vector& x, int32_t i, real a) const = 0;
-  virtual void averageRowsToVector(Vector& x, const std::vector<int32_t>& rows) const = 0;
+  virtual void averageRowsToVector(Vector& x, Span<const int32_t> rows) const = 0;
   virtual void save(std::ostream&) const = 0;
   virtual void load(std::istream&) = 0;
   virtual void dump(std::ostream&) const = 0;
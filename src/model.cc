@@ -18,9 +18,11 @@ namespace fasttext {
 Model::State::State(int32_t hiddenSize, int32_t outputSize, int32_t seed)
     : lossValue_(0.0),
       nexamples_(0),
+      slots_(),
       hidden(hiddenSize),
       output(outputSize),
       grad(hiddenSize),
+      uniqueInput(),
       rng(seed) {}
 
 real Model::State::getLoss() const {
@@ -32,6 +34,38 @@ void Model::State::incrementNExamples(real loss) {
   nexamples_++;
 }
 
+void Model::State::coalesceInput(Span<const int32_t> input) {
+  size_t capacity = 16;
+  while (capacity < 2 * input.size()) {
+    capacity <<= 1;
+  }
+  if (slots_.size() < capacity) {
+    slots_.assign(capacity, -1);
+  }
+  const size_t mask = slots_.size() - 1;
+  uniqueInput.clear();
+  for (int32_t id : input) {
+    size_t h = (uint32_t(id) * 2654435761u) & mask;
+    while (slots_[h] != -1 && uniqueInput[slots_[h]].first != id) {
+      h = (h + 1) & mask;
+    }
+    if (slots_[h] == -1) {
+      slots_[h] = uniqueInput.size();
+      uniqueInput.emplace_back(id, 1);
+    } else {
+      uniqueInput[slots_[h]].second++;
+    }
+  }
+  // Only the slots used by this input need to be cleared again.
+  for (const auto& row : uniqueInput) {
+    size_t h = (uint32_t(row.first) * 2654435761u) & mask;
+    while (slots_[h] == -1 || uniqueInput[slots_[h]].first != row.first) {
+      h = (h + 1) & mask;
+    }
+    slots_[h] = -1;
+  }
+}
+
 Model::Model(
     std::shared_ptr<Matrix> wi,
     std::shared_ptr<Matrix> wo,
@@ -39,14 +73,14 @@ Model::Model(
     bool normalizeGradient)
     : wi_(wi), wo_(wo), loss_(loss), normalizeGradient_(normalizeGradient) {}
 
-void Model::computeHidden(const std::vector<int32_t>& input, State& state)
+void Model::computeHidden(Span<const int32_t> input, State& state)
     const {
   Vector& hidden = state.hidden;
   wi_->averageRowsToVector(hidden, input);
 }
 
 void Model::predict(
-    const std::vector<int32_t>& input,
+    Span<const int32_t> input,
     int32_t k,
     real threshold,
     Predictions& heap,
@@ -63,7 +97,7 @@ void Model::predict(
 }
 
 void Model::update(
-    const std::vector<int32_t>& input,
+    Span<const int32_t> input,
     const std::vector<int32_t>& targets,
     int32_t targetIndex,
     real lr,
@@ -81,8 +115,11 @@ void Model::update(
   if (normalizeGradient_) {
     grad.mul(1.0 / input.size());
   }
-  for (auto it = input.cbegin(); it != input.cend(); ++it) {
-    wi_->addVectorToRow(grad, *it, 1.0);
+  // Word n-grams and subwords often hit the same bucket several times in one
+  // example: apply the gradient once per distinct row, scaled by its count.
+  state.coalesceInput(input);
+  for (const auto& row : state.uniqueInput) {
+    wi_->addVectorToRow(grad, row.first, real(row.second));
   }
 }
 
@@ -44,31 +44,34 @@ class Model {
    private:
     real lossValue_;
     int64_t nexamples_;
+    std::vector<int32_t> slots_;
 
    public:
     Vector hidden;
     Vector output;
     Vector grad;
+    std::vector<std::pair<int32_t, int32_t>> uniqueInput;
     std::minstd_rand rng;
 
     State(int32_t hiddenSize, int32_t outputSize, int32_t seed);
     real getLoss() const;
     void incrementNExamples(real loss);
+    void coalesceInput(Span<const int32_t> input);
   };
 
   void predict(
-      const std::vector<int32_t>& input,
+      Span<const int32_t> input,
       int32_t k,
       real threshold,
       Predictions& heap,
       State& state) const;
   void update(
-      const std::vector<int32_t>& input,
+      Span<const int32_t> input,
       const std::vector<int32_t>& targets,
       int32_t targetIndex,
       real lr,
       State& state);
-  void computeHidden(const std::vector<int32_t>& input, State& state) const;
+  void computeHidden(Span<const int32_t> input, State& state) const;
 
   real std_log(real) const;
 
@@ -8,29 +8,78 @@
 
 #include "productquantizer.h"
 
+#include <assert.h>
 #include <algorithm>
 #include <iostream>
 #include <numeric>
 #include <stdexcept>
 #include <string>
 
+#include "simd.h"
+#include "utils.h"
+
 namespace fasttext {
 
-real distL2(const real* x, const real* y, int32_t d) {
-  real dist = 0;
-  for (auto i = 0; i < d; i++) {
-    auto tmp = x[i] - y[i];
-    dist += tmp * tmp;
+// Squared distances from x to the ksub centroids of dimension d stored
+// transposed in ct, i.e. ct[j * ksub + k] is coordinate j of centroid k, so
+// that one register holds the distances to several centroids.
+void distL2(
+    const real* x,
+    const real* ct,
+    real* dis,
+    int32_t d,
+    int32_t ksub) {
+  int32_t k = 0;
+#if defined(__AVX512F__) || defined(__AVX__) || defined(__SSE__)
+  constexpr int32_t kWidth = sizeof(Register) / sizeof(real);
+  for (; k + kWidth <= ksub; k += kWidth) {
+    Register sum = Set1(0);
+    for (auto j = 0; j < d; j++) {
+      Register diff = Subtract(Set1(x[j]), LoadU(ct + j * ksub + k));
+      sum = Add(sum, Multiply(diff, diff));
+    }
+    StoreU(dis + k, sum);
+  }
+#endif
+  for (; k < ksub; k++) {
+    real dist = 0;
+    for (auto j = 0; j < d; j++) {
+      auto tmp = x[j] - ct[j * ksub + k];
+      dist += tmp * tmp;
+    }
+    dis[k] = dist;
+  }
+}
+
+inline uint8_t getCode(const uint8_t* code, int32_t m, int32_t nbits) {
+  if (nbits == 8) {
+    return code[m];
   }
-  return dist;
+  return (code[m >> 1] >> ((m & 1) << 2)) & 0xf;
 }
 
-ProductQuantizer::ProductQuantizer(int32_t dim, int32_t dsub)
-    : dim_(dim),
-      nsubq_(dim / dsub),
-      dsub_(dsub),
-      centroids_(dim * ksub_),
-      rng(seed_) {
+ProductQuantizer::ProductQuantizer() : ProductQuantizer(8) {}
+
+ProductQuantizer::ProductQuantizer(int32_t nbits)
+    : nbits_(nbits),
+      ksub_(1 << nbits),
+      dim_(0),
+      nsubq_(0),
+      dsub_(0),
+      lastdsub_(0) {
+  if (nbits_ != 4 && nbits_ != 8) {
+    throw std::invalid_argument(
+        "Product quantization codes must have 4 or 8 bits, not " +
+        std::to_string(nbits_));
+  }
+}
+
+ProductQuantizer::ProductQuantizer(int32_t dim, int32_t dsub, int32_t nbits)
+    : ProductQuantizer(nbits) {
+  dim_ = dim;
+  nsubq_ = dim / dsub;
+  dsub_ = dsub;
+  centroids_.resize(dim * ksub_);
   lastdsub_ = dim_ % dsub;
   if (lastdsub_ == 0) {
     lastdsub_ = dsub_;
@@ -53,20 +102,30 @@ real* ProductQuantizer::get_centroids(int32_t m, uint8_t i) {
   return &centroids_[(m * ksub_ + i) * dsub_];
 }
 
+void ProductQuantizer::transpose_centroids(
+    const real* c,
+    real* ct,
+    int32_t d) const {
+  for (auto k = 0; k < ksub_; k++) {
+    for (auto j = 0; j < d; j++) {
+      ct[j * ksub_ + k] = c[k * d + j];
+    }
+  }
+}
+
 real ProductQuantizer::assign_centroid(
     const real* x,
-    const real* c0,
+    const real* ct,
     uint8_t* code,
     int32_t d) const {
-  const real* c = c0;
-  real dis = distL2(x, c, d);
+  real dists[1 << 8];
+  distL2(x, ct, dists, d, ksub_);
+  real dis = dists[0];
   code[0] = 0;
   for (auto j = 1; j < ksub_; j++) {
-    c += d;
-    real disij = distL2(x, c, d);
-    if (disij < dis) {
+    if (dists[j] < dis) {
       code[0] = (uint8_t)j;
-      dis = disij;
+      dis = dists[j];
     }
   }
   return dis;
@@ -77,10 +136,15 @@ void ProductQuantizer::Estep(
     const real* centroids,
     uint8_t* codes,
     int32_t d,
-    int32_t n) const {
-  for (auto i = 0; i < n; i++) {
-    assign_centroid(x + i * d, centroids, codes + i, d);
-  }
+    int32_t n,
+    int32_t thread) const {
+  std::vector<real> ct(ksub_ * d);
+  transpose_centroids(centroids, ct.data(), d);
+  utils::parallelFor(n, thread, [&](int32_t begin, int32_t end) {
+    for (auto i = begin; i < end; i++) {
+      assign_centroid(x + i * d, ct.data(), codes + i, d);
+    }
+  });
 }
 
 void ProductQuantizer::MStep(
@@ -88,7 +152,8 @@ void ProductQuantizer::MStep(
     real* centroids,
     const uint8_t* codes,
     int32_t d,
-    int32_t n) {
+    int32_t n,
+    std::minstd_rand& rng) const {
   std::vector<int32_t> nelts(ksub_, 0);
   memset(centroids, 0, sizeof(real) * d * ksub_);
   const real* x = x0;
@@ -132,7 +197,13 @@ void ProductQuantizer::MStep(
   }
 }
 
-void ProductQuantizer::kmeans(const real* x, real* c, int32_t n, int32_t d) {
+void ProductQuantizer::kmeans(
+    const real* x,
+    real* c,
+    int32_t n,
+    int32_t d,
+    std::minstd_rand& rng,
+    int32_t thread) const {
   std::vector<int32_t> perm(n, 0);
   std::iota(perm.begin(), perm.end(), 0);
   std::shuffle(perm.begin(), perm.end(), rng);
@@ -141,39 +212,103 @@ void ProductQuantizer::kmeans(const real* x, real* c, int32_t n, int32_t d) {
   }
   auto codes = std::vector<uint8_t>(n);
   for (auto i = 0; i < niter_; i++) {
-    Estep(x, c, codes.data(), d, n);
-    MStep(x, c, codes.data(), d, n);
+    Estep(x, c, codes.data(), d, n, thread);
+    MStep(x, c, codes.data(), d, n, rng);
   }
 }
 
-void ProductQuantizer::train(int32_t n, const real* x) {
+// Sub-quantizers are trained independently, each with its own generator, so
+// that the centroids do not depend on the number of threads. When there are
+// fewer sub-quantizers than threads, the E-steps are split across points.
+void ProductQuantizer::train(int32_t n, const real* x, int32_t thread) {
   if (n < ksub_) {
     throw std::invalid_argument(
         "Matrix too small for quantization, must have at least " +
         std::to_string(ksub_) + " rows");
   }
-  std::vector<int32_t> perm(n, 0);
-  std::iota(perm.begin(), perm.end(), 0);
+  auto np = std::min(n, max_points_per_cluster_ * ksub_);
+  int32_t subqThread = nsubq_ < thread ? 1 : thread;
+  int32_t estepThread = nsubq_ < thread ? thread : 1;
+  utils::parallelFor(nsubq_, subqThread, [&](int32_t begin, int32_t end) {
+    std::vector<int32_t> perm(n, 0);
+    auto xslice = std::vector<real>(np * dsub_);
+    for (auto m = begin; m < end; m++) {
+      auto d = m == nsubq_ - 1 ? lastdsub_ : dsub_;
+      std::minstd_rand rng(seed_ + m);
+      std::iota(perm.begin(), perm.end(), 0);
+      if (np != n) {
+        std::shuffle(perm.begin(), perm.end(), rng);
+      }
+      for (auto j = 0; j < np; j++) {
+        memcpy(
+            xslice.data() + j * d,
+            x + perm[j] * dim_ + m * dsub_,
+            d * sizeof(real));
+      }
+      kmeans(xslice.data(), get_centroids(m, 0), np, d, rng, estepThread);
+    }
+  });
+}
+
+int32_t ProductQuantizer::nbits() const {
+  return nbits_;
+}
+
+int32_t ProductQuantizer::code_size() const {
+  return (nsubq_ * nbits_ + 7) / 8;
+}
+
+void ProductQuantizer::compute_dot_table(
+    const Vector& x,
+    std::vector<real>& table) const {
+  table.resize(nsubq_ * ksub_);
   auto d = dsub_;
-  auto np = std::min(n, max_points_);
-  auto xslice = std::vector<real>(np * dsub_);
   for (auto m = 0; m < nsubq_; m++) {
     if (m == nsubq_ - 1) {
       d = lastdsub_;
     }
-    if (np != n) {
-      std::shuffle(perm.begin(), perm.end(), rng);
+    const real* c = get_centroids(m, 0);
+    for (auto k = 0; k < ksub_; k++) {
+      real dot = 0.0;
+      for (auto n = 0; n < d; n++) {
+        dot += x[m * dsub_ + n] * c[n];
+      }
+      table[m * ksub_ + k] = dot;
+      c += d;
     }
-    for (auto j = 0; j < np; j++) {
-      memcpy(
-          xslice.data() + j * d,
-          x + perm[j] * dim_ + m * dsub_,
-          d * sizeof(real));
+  }
+  if (nbits_ == 4) {
+    // one lookup per byte, for the two sub-quantizers it codes
+    std::vector<real> pairs(code_size() * 256);
+    for (auto p = 0; p < code_size(); p++) {
+      const real* low = table.data() + 2 * p * ksub_;
+      for (auto b = 0; b < 256; b++) {
+        pairs[p * 256 + b] = low[b & 0xf];
+        if (2 * p + 1 < nsubq_) {
+          pairs[p * 256 + b] += low[ksub_ + (b >> 4)];
+        }
+      }
     }
-    kmeans(xslice.data(), get_centroids(m, 0), np, d);
+    table.swap(pairs);
   }
 }
 
+real ProductQuantizer::mulcode(
+    const std::vector<real>& table,
+    const uint8_t* codes,
+    int32_t t,
+    real alpha) const {
+  real res = 0.0;
+  auto size = code_size();
+  const uint8_t* code = codes + size * t;
+  const real* row = table.data();
+  for (auto p = 0; p < size; p++) {
+    res += row[code[p]];
+    row += 256;
+  }
+  return res * alpha;
+}
+
 real ProductQuantizer::mulcode(
     const Vector& x,
     const uint8_t* codes,
@@ -181,9 +316,9 @@ real ProductQuantizer::mulcode(
     real alpha) const {
   real res = 0.0;
   auto d = dsub_;
-  const uint8_t* code = codes + nsubq_ * t;
+  const uint8_t* code = codes + code_size() * t;
   for (auto m = 0; m < nsubq_; m++) {
-    const real* c = get_centroids(m, code[m]);
+    const real* c = get_centroids(m, getCode(code, m, nbits_));
     if (m == nsubq_ - 1) {
       d = lastdsub_;
     }
@@ -200,9 +335,9 @@ void ProductQuantizer::addcode(
     int32_t t,
     real alpha) const {
   auto d = dsub_;
-  const uint8_t* code = codes + nsubq_ * t;
+  const uint8_t* code = codes + code_size() * t;
   for (auto m = 0; m < nsubq_; m++) {
-    const real* c = get_centroids(m, code[m]);
+    const real* c = get_centroids(m, getCode(code, m, nbits_));
     if (m == nsubq_ - 1) {
       d = lastdsub_;
     }
@@ -212,21 +347,127 @@ void ProductQuantizer::addcode(
   }
 }
 
-void ProductQuantizer::compute_code(const real* x, uint8_t* code) const {
+// Writes the average of the sub-quantizer m slices of the given rows, each
+// scaled by its alpha if alphas is not null, into x. The sum over the rows
+// is kept in registers and x is written once.
+template <int32_t Dsub, int32_t Nbits>
+void averageSlices(
+    real* x,
+    const real* centroids,
+    const uint8_t* codes,
+    int32_t m,
+    int32_t codeSize,
+    Span<const int32_t> rows,
+    const real* alphas) {
+  real sum[Dsub] = {};
+  for (size_t i = 0; i < rows.size(); i++) {
+    const uint8_t* code = codes + (int64_t)codeSize * rows[i];
+    const real* c = centroids + getCode(code, m, Nbits) * Dsub;
+    real alpha = alphas ? alphas[i] : 1.0;
+    for (auto n = 0; n < Dsub; n++) {
+      sum[n] += alpha * c[n];
+    }
+  }
+  real scale = 1.0 / rows.size();
+  for (auto n = 0; n < Dsub; n++) {
+    x[n] = sum[n] * scale;
+  }
+}
+
+template <int32_t Dsub>
+void averageSlices(
+    real* x,
+    const real* centroids,
+    const uint8_t* codes,
+    int32_t m,
+    int32_t codeSize,
+    int32_t nbits,
+    Span<const int32_t> rows,
+    const real* alphas) {
+  if (nbits == 8) {
+    averageSlices<Dsub, 8>(x, centroids, codes, m, codeSize, rows, alphas);
+  } else {
+    averageSlices<Dsub, 4>(x, centroids, codes, m, codeSize, rows, alphas);
+  }
+}
+
+void ProductQuantizer::averagecodes(
+    Vector& x,
+    const uint8_t* codes,
+    Span<const int32_t> rows,
+    const real* alphas) const {
+  assert(x.size() == dim_);
+  auto size = code_size();
+  for (auto m = 0; m < nsubq_; m++) {
+    auto d = m == nsubq_ - 1 ? lastdsub_ : dsub_;
+    real* xm = x.data() + m * dsub_;
+    const real* c = get_centroids(m, 0);
+    switch (d) {
+      case 1:
+        averageSlices<1>(xm, c, codes, m, size, nbits_, rows, alphas);
+        break;
+      case 2:
+        averageSlices<2>(xm, c, codes, m, size, nbits_, rows, alphas);
+        break;
+      case 4:
+        averageSlices<4>(xm, c, codes, m, size, nbits_, rows, alphas);
+        break;
+      case 8:
+        averageSlices<8>(xm, c, codes, m, size, nbits_, rows, alphas);
+        break;
+      default:
+        for (auto n = 0; n < d; n++) {
+          real sum = 0.0;
+          for (size_t i = 0; i < rows.size(); i++) {
+            real alpha = alphas ? alphas[i] : 1.0;
+            const uint8_t* code = codes + (int64_t)size * rows[i];
+            sum += alpha * c[getCode(code, m, nbits_) * d + n];
+          }
+          xm[n] = sum * (1.0 / rows.size());
+        }
+    }
+  }
+}
+
+void ProductQuantizer::compute_code(
+    const real* x,
+    uint8_t* code,
+    const real* ct) const {
   auto d = dsub_;
+  memset(code, 0, code_size());
   for (auto m = 0; m < nsubq_; m++) {
     if (m == nsubq_ - 1) {
       d = lastdsub_;
     }
-    assign_centroid(x + m * dsub_, get_centroids(m, 0), code + m, d);
+    uint8_t k;
+    assign_centroid(x + m * dsub_, ct + m * ksub_ * dsub_, &k, d);
+    if (nbits_ == 8) {
+      code[m] = k;
+    } else {
+      code[m >> 1] |= k << ((m & 1) << 2);
+    }
   }
 }
 
-void ProductQuantizer::compute_codes(const real* x, uint8_t* codes, int32_t n)
-    const {
-  for (auto i = 0; i < n; i++) {
-    compute_code(x + i * dim_, codes + i * nsubq_);
+void ProductQuantizer::compute_codes(
+    const real* x,
+    uint8_t* codes,
+    int32_t n,
+    int32_t thread) const {
+  std::vector<real> ct(centroids_.size());
+  auto d = dsub_;
+  for (auto m = 0; m < nsubq_; m++) {
+    if (m == nsubq_ - 1) {
+      d = lastdsub_;
+    }
+    transpose_centroids(get_centroids(m, 0), ct.data() + m * ksub_ * dsub_, d);
   }
+  utils::parallelFor(n, thread, [&](int32_t begin, int32_t end) {
+    for (auto i = begin; i < end; i++) {
+      compute_code(
+          x + (int64_t)i * dim_, codes + (int64_t)i * code_size(), ct.data());
+    }
+  });
 }
 
 void ProductQuantizer::save(std::ostream& out) const {
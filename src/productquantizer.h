@@ -15,20 +15,21 @@
 #include <vector>
 
 #include "real.h"
+#include "span.h"
 #include "vector.h"
 
 namespace fasttext {
 
 class ProductQuantizer {
  protected:
-  const int32_t nbits_ = 8;
-  const int32_t ksub_ = 1 << nbits_;
   const int32_t max_points_per_cluster_ = 256;
-  const int32_t max_points_ = max_points_per_cluster_ * ksub_;
   const int32_t seed_ = 1234;
   const int32_t niter_ = 25;
   const real eps_ = 1e-7;
 
+  int32_t nbits_;
+  int32_t ksub_;
+
   int32_t dim_;
   int32_t nsubq_;
   int32_t dsub_;
@@ -36,25 +37,59 @@ class ProductQuantizer {
 
   std::vector<real> centroids_;
 
-  std::minstd_rand rng;
-
  public:
-  ProductQuantizer() {}
-  ProductQuantizer(int32_t, int32_t);
+  ProductQuantizer();
+  explicit ProductQuantizer(int32_t nbits);
+  ProductQuantizer(int32_t, int32_t, int32_t nbits = 8);
 
   real* get_centroids(int32_t, uint8_t);
   const real* get_centroids(int32_t, uint8_t) const;
 
+  // The centroids of a sub-quantizer transposed, with coordinate j of all
+  // ksub_ centroids contiguous, as expected by assign_centroid.
+  void transpose_centroids(const real*, real*, int32_t) const;
   real assign_centroid(const real*, const real*, uint8_t*, int32_t) const;
-  void Estep(const real*, const real*, uint8_t*, int32_t, int32_t) const;
-  void MStep(const real*, real*, const uint8_t*, int32_t, int32_t);
-  void kmeans(const real*, real*, int32_t, int32_t);
-  void train(int, const real*);
+  void Estep(
+      const real*,
+      const real*,
+      uint8_t*,
+      int32_t,
+      int32_t,
+      int32_t thread = 1) const;
+  void MStep(
+      const real*,
+      real*,
+      const uint8_t*,
+      int32_t,
+      int32_t,
+      std::minstd_rand&) const;
+  void kmeans(
+      const real*,
+      real*,
+      int32_t,
+      int32_t,
+      std::minstd_rand&,
+      int32_t thread = 1) const;
+  void train(int, const real*, int32_t thread = 1);
+
+  int32_t nbits() const;
+  // Number of bytes of the code of one vector. With 4 bits, the codes of
+  // sub-quantizers 2p and 2p + 1 are the low and high nibbles of byte p.
+  int32_t code_size() const;
 
   real mulcode(const Vector&, const uint8_t*, int32_t, real) const;
+  // table[p * 256 + b] is the dot product of a vector with the centroids
+  // selected by value b of byte p of a code.
+  void compute_dot_table(const Vector&, std::vector<real>&) const;
+  real mulcode(const std::vector<real>&, const uint8_t*, int32_t, real) const;
   void addcode(Vector&, const uint8_t*, int32_t, real) const;
-  void compute_code(const real*, uint8_t*) const;
-  void compute_codes(const real*, uint8_t*, int32_t) const;
+  void averagecodes(
+      Vector&,
+      const uint8_t*,
+      Span<const int32_t>,
+      const real*) const;
+  void compute_code(const real*, uint8_t*, const real*) const;
+  void compute_codes(const real*, uint8_t*, int32_t, int32_t thread = 1) const;
 
   void save(std::ostream&) const;
   void load(std::istream&);
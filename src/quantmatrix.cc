@@ -9,44 +9,228 @@
 #include "quantmatrix.h"
 
 #include <assert.h>
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <stdexcept>
 
 namespace fasttext {
 
+// The first byte of a saved matrix used to be the qnorm bool. It now holds
+// flags, and kExtendedHeader announces the fields that older versions did
+// not write.
+constexpr uint8_t kQuantNorm = 1;
+constexpr uint8_t kExtendedHeader = 2;
+constexpr uint8_t kRotation = 4;
+
+constexpr int32_t kRotationIterations = 4;
+constexpr int64_t kRotationSampleSize = 65536;
+
+// c = a^T b, for a and b with the same number of rows.
+void multiplyTransposed(
+    const DenseMatrix& a,
+    const DenseMatrix& b,
+    DenseMatrix& c) {
+  c.zero();
+  for (int64_t i = 0; i < a.size(0); i++) {
+    for (int64_t k = 0; k < a.size(1); k++) {
+      real aik = a.at(i, k);
+      for (int64_t j = 0; j < b.size(1); j++) {
+        c.at(k, j) += aik * b.at(i, j);
+      }
+    }
+  }
+}
+
+// Closest orthogonal matrix to m (the U V^T of its SVD), which minimizes
+// ||X R - Y|| when m = X^T Y. It is the limit of the Newton-Schulz
+// iteration q <- q (3 I - q^T q) / 2, the result being orthonormalized in
+// case some singular values had not converged.
+void polarFactor(const DenseMatrix& m, DenseMatrix& q) {
+  const int64_t n = m.size(0);
+  real norm = 0.0;
+  for (int64_t i = 0; i < n; i++) {
+    for (int64_t j = 0; j < n; j++) {
+      norm += m.at(i, j) * m.at(i, j);
+    }
+  }
+  norm = std::sqrt(norm);
+  for (int64_t i = 0; i < n; i++) {
+    for (int64_t j = 0; j < n; j++) {
+      q.at(i, j) = norm > 0 ? m.at(i, j) / norm : (i == j);
+    }
+  }
+  DenseMatrix s(n, n);
+  DenseMatrix next(n, n);
+  for (int32_t it = 0; it < 100; it++) {
+    multiplyTransposed(q, q, s);
+    real error = 0.0;
+    for (int64_t i = 0; i < n; i++) {
+      for (int64_t j = 0; j < n; j++) {
+        s.at(i, j) = (i == j ? 3.0 : 0.0) - s.at(i, j);
+        error = std::max(error, std::abs(s.at(i, j) - (i == j ? 2 : 0)));
+      }
+    }
+    if (error < 1e-5) {
+      break;
+    }
+    next.zero();
+    for (int64_t i = 0; i < n; i++) {
+      for (int64_t k = 0; k < n; k++) {
+        real qik = 0.5 * q.at(i, k);
+        for (int64_t j = 0; j < n; j++) {
+          next.at(i, j) += qik * s.at(k, j);
+        }
+      }
+    }
+    std::copy(next.data(), next.data() + n * n, q.data());
+  }
+  // Gram-Schmidt on the columns, replacing degenerate ones by the first
+  // canonical basis vector that is independent of the previous columns.
+  Vector col(n);
+  int64_t basis = 0;
+  for (int64_t j = 0; j < n; j++) {
+    for (int64_t i = 0; i < n; i++) {
+      col[i] = q.at(i, j);
+    }
+    while (true) {
+      for (int64_t k = 0; k < j; k++) {
+        real dot = 0.0;
+        for (int64_t i = 0; i < n; i++) {
+          dot += col[i] * q.at(i, k);
+        }
+        for (int64_t i = 0; i < n; i++) {
+          col[i] -= dot * q.at(i, k);
+        }
+      }
+      if (col.norm() > 1e-3) {
+        break;
+      }
+      for (int64_t i = 0; i < n; i++) {
+        col[i] = (i == basis);
+      }
+      basis++;
+    }
+    col.mul(1.0 / col.norm());
+    for (int64_t i = 0; i < n; i++) {
+      q.at(i, j) = col[i];
+    }
+  }
+}
+
 QuantMatrix::QuantMatrix() : Matrix(), qnorm_(false), codesize_(0) {}
 
-QuantMatrix::QuantMatrix(DenseMatrix&& mat, int32_t dsub, bool qnorm)
-    : Matrix(mat.size(0), mat.size(1)),
-      qnorm_(qnorm),
-      codesize_(mat.size(0) * ((mat.size(1) + dsub - 1) / dsub)) {
+QuantMatrix::QuantMatrix(
+    DenseMatrix&& mat,
+    int32_t dsub,
+    bool qnorm,
+    int32_t thread,
+    int32_t nbits,
+    bool opq)
+    : Matrix(mat.size(0), mat.size(1)), qnorm_(qnorm), codesize_(0) {
+  pq_ = std::unique_ptr<ProductQuantizer>(
+      new ProductQuantizer(n_, dsub, nbits));
+  codesize_ = m_ * pq_->code_size();
   codes_.resize(codesize_);
-  pq_ = std::unique_ptr<ProductQuantizer>(new ProductQuantizer(n_, dsub));
   if (qnorm_) {
     norm_codes_.resize(m_);
     npq_ = std::unique_ptr<ProductQuantizer>(new ProductQuantizer(1, 1));
   }
-  quantize(std::forward<DenseMatrix>(mat));
+  if (opq) {
+    rotation_ = std::unique_ptr<DenseMatrix>(new DenseMatrix(n_, n_));
+  }
+  quantize(std::forward<DenseMatrix>(mat), thread);
+}
+
+// Alternates between training a product quantizer on the rotated rows of a
+// sample and setting the rotation to the one that best maps the rows onto
+// their reconstructions (Ge et al., Optimized Product Quantization).
+void QuantMatrix::trainRotation(const DenseMatrix& mat, int32_t thread) {
+  assert(rotation_);
+  const int64_t np = std::min(m_, kRotationSampleSize);
+  DenseMatrix x(np, n_);
+  for (int64_t i = 0; i < np; i++) {
+    const real* row = mat.data() + (i * m_ / np) * n_;
+    std::copy(row, row + n_, x.data() + i * n_);
+  }
+  rotation_->zero();
+  for (int64_t i = 0; i < n_; i++) {
+    rotation_->at(i, i) = 1.0;
+  }
+  DenseMatrix xr(np, n_);
+  DenseMatrix correlation(n_, n_);
+  std::vector<uint8_t> codes(np * pq_->code_size());
+  Vector in(n_), out(n_);
+  for (int32_t it = 0; it < kRotationIterations; it++) {
+    for (int64_t i = 0; i < np; i++) {
+      std::copy(x.data() + i * n_, x.data() + (i + 1) * n_, in.data());
+      rotate(in, out);
+      std::copy(out.data(), out.data() + n_, xr.data() + i * n_);
+    }
+    ProductQuantizer pq(*pq_);
+    pq.train(np, xr.data(), thread);
+    pq.compute_codes(xr.data(), codes.data(), np, thread);
+    for (int64_t i = 0; i < np; i++) {
+      out.zero();
+      pq.addcode(out, codes.data(), i, 1.0);
+      std::copy(out.data(), out.data() + n_, xr.data() + i * n_);
+    }
+    multiplyTransposed(x, xr, correlation);
+    polarFactor(correlation, *rotation_);
+  }
 }
 
-void QuantMatrix::quantizeNorm(const Vector& norms) {
+// y = x R, the rotated space in which the rows are quantized.
+void QuantMatrix::rotate(const Vector& x, Vector& y) const {
+  y.zero();
+  for (int64_t k = 0; k < n_; k++) {
+    const real* row = rotation_->data() + k * n_;
+    for (int64_t j = 0; j < n_; j++) {
+      y[j] += x[k] * row[j];
+    }
+  }
+}
+
+// x = y R^T, back from the rotated space.
+void QuantMatrix::unrotate(const Vector& y, Vector& x) const {
+  for (int64_t k = 0; k < n_; k++) {
+    const real* row = rotation_->data() + k * n_;
+    real dot = 0.0;
+    for (int64_t j = 0; j < n_; j++) {
+      dot += y[j] * row[j];
+    }
+    x[k] = dot;
+  }
+}
+
+void QuantMatrix::quantizeNorm(const Vector& norms, int32_t thread) {
   assert(qnorm_);
   assert(norms.size() == m_);
   auto dataptr = norms.data();
-  npq_->train(m_, dataptr);
-  npq_->compute_codes(dataptr, norm_codes_.data(), m_);
+  npq_->train(m_, dataptr, thread);
+  npq_->compute_codes(dataptr, norm_codes_.data(), m_, thread);
 }
 
-void QuantMatrix::quantize(DenseMatrix&& mat) {
+void QuantMatrix::quantize(DenseMatrix&& mat, int32_t thread) {
   if (qnorm_) {
     Vector norms(mat.size(0));
-    mat.l2NormRow(norms);
+    mat.l2NormRow(norms, thread);
     mat.divideRow(norms);
-    quantizeNorm(norms);
+    quantizeNorm(norms, thread);
+  }
+  if (rotation_) {
+    trainRotation(mat, thread);
+    Vector in(n_), out(n_);
+    for (int64_t i = 0; i < m_; i++) {
+      real* row = mat.data() + i * n_;
+      std::copy(row, row + n_, in.data());
+      rotate(in, out);
+      std::copy(out.data(), out.data() + n_, row);
+    }
   }
   auto dataptr = mat.data();
-  pq_->train(m_, dataptr);
-  pq_->compute_codes(dataptr, codes_.data(), m_);
+  pq_->train(m_, dataptr, thread);
+  pq_->compute_codes(dataptr, codes_.data(), m_, thread);
 }
 
 real QuantMatrix::dotRow(const Vector& vec, int64_t i) const {
@@ -57,9 +241,47 @@ real QuantMatrix::dotRow(const Vector& vec, int64_t i) const {
   if (qnorm_) {
     norm = npq_->get_centroids(0, norm_codes_[i])[0];
   }
+  if (rotation_) {
+    Vector rotated(n_);
+    rotate(vec, rotated);
+    return pq_->mulcode(rotated, codes_.data(), i, norm);
+  }
   return pq_->mulcode(vec, codes_.data(), i, norm);
 }
 
+// Scoring every row against the same vector is done with a table of the dot
+// products between the vector and all the centroids, with one entry per
+// value of each code byte, which pays off once there are more rows than
+// entries per byte. With a rotation, the vector is rotated once for all the
+// rows.
+void QuantMatrix::dotRowsToVector(Vector& x, const Vector& vec) const {
+  assert(x.size() == m_);
+  assert(vec.size() == n_);
+  auto norm = [&](int64_t i) -> real {
+    return qnorm_ ? npq_->get_centroids(0, norm_codes_[i])[0] : 1.0;
+  };
+  auto score = [&](const Vector& query) {
+    if (m_ < 256) {
+      for (int64_t i = 0; i < m_; i++) {
+        x[i] = pq_->mulcode(query, codes_.data(), i, norm(i));
+      }
+      return;
+    }
+    std::vector<real> table;
+    pq_->compute_dot_table(query, table);
+    for (int64_t i = 0; i < m_; i++) {
+      x[i] = pq_->mulcode(table, codes_.data(), i, norm(i));
+    }
+  };
+  if (rotation_) {
+    Vector rotated(n_);
+    rotate(vec, rotated);
+    score(rotated);
+    return;
+  }
+  score(vec);
+}
+
 void QuantMatrix::addVectorToRow(const Vector&, int64_t, real) {
   throw std::runtime_error("Operation not permitted on quantized matrices.");
 }
@@ -69,27 +291,57 @@ void QuantMatrix::addRowToVector(Vector& x, int32_t i, real a) const {
   if (qnorm_) {
     norm = npq_->get_centroids(0, norm_codes_[i])[0];
   }
+  if (rotation_) {
+    Vector rotated(n_), row(n_);
+    rotated.zero();
+    pq_->addcode(rotated, codes_.data(), i, a * norm);
+    unrotate(rotated, row);
+    x.addVector(row);
+    return;
+  }
   pq_->addcode(x, codes_.data(), i, a * norm);
 }
 
 void QuantMatrix::addRowToVector(Vector& x, int32_t i) const {
-  real norm = 1;
-  if (qnorm_) {
-    norm = npq_->get_centroids(0, norm_codes_[i])[0];
-  }
-  pq_->addcode(x, codes_.data(), i, norm);
+  addRowToVector(x, i, 1.0);
 }
 
-void QuantMatrix::averageRowsToVector(Vector& x, const std::vector<int32_t>& rows) const {
-  x.zero();
-  for (auto it = rows.cbegin(); it != rows.cend(); ++it) {
-    addRowToVector(x, *it);
+void QuantMatrix::averageRowsToVector(Vector& x, Span<const int32_t> rows) const {
+  auto average = [&](Vector& y) {
+    if (!qnorm_) {
+      pq_->averagecodes(y, codes_.data(), rows, nullptr);
+      return;
+    }
+    std::vector<real> norms(rows.size());
+    for (size_t i = 0; i < rows.size(); i++) {
+      norms[i] = npq_->get_centroids(0, norm_codes_[rows[i]])[0];
+    }
+    pq_->averagecodes(y, codes_.data(), rows, norms.data());
+  };
+  if (rotation_) {
+    // the average of the rows is the average of the rotated rows, rotated
+    // back once
+    Vector rotated(n_);
+    average(rotated);
+    unrotate(rotated, x);
+    return;
   }
-  x.mul(1.0 / rows.size());
+  average(x);
 }
 
 void QuantMatrix::save(std::ostream& out) const {
-  out.write((char*)&qnorm_, sizeof(qnorm_));
+  int32_t nbits = pq_->nbits();
+  uint8_t flags = qnorm_ ? kQuantNorm : 0;
+  if (nbits != 8) {
+    flags |= kExtendedHeader;
+  }
+  if (rotation_) {
+    flags |= kRotation;
+  }
+  out.write((char*)&flags, sizeof(flags));
+  if (flags & kExtendedHeader) {
+    out.write((char*)&nbits, sizeof(nbits));
+  }
   out.write((char*)&m_, sizeof(m_));
   out.write((char*)&n_, sizeof(n_));
   out.write((char*)&codesize_, sizeof(codesize_));
@@ -99,16 +351,28 @@ void QuantMatrix::save(std::ostream& out) const {
     out.write((char*)norm_codes_.data(), m_ * sizeof(uint8_t));
     npq_->save(out);
   }
+  if (rotation_) {
+    rotation_->save(out);
+  }
 }
 
 void QuantMatrix::load(std::istream& in) {
-  in.read((char*)&qnorm_, sizeof(qnorm_));
+  uint8_t flags;
+  int32_t nbits = 8;
+  in.read((char*)&flags, sizeof(flags));
+  if (flags & ~(kQuantNorm | kExtendedHeader | kRotation)) {
+    throw std::invalid_argument("Unsupported quantized matrix format!");
+  }
+  qnorm_ = flags & kQuantNorm;
+  if (flags & kExtendedHeader) {
+    in.read((char*)&nbits, sizeof(nbits));
+  }
   in.read((char*)&m_, sizeof(m_));
   in.read((char*)&n_, sizeof(n_));
   in.read((char*)&codesize_, sizeof(codesize_));
   codes_ = std::vector<uint8_t>(codesize_);
   in.read((char*)codes_.data(), codesize_ * sizeof(uint8_t));
-  pq_ = std::unique_ptr<ProductQuantizer>(new ProductQuantizer());
+  pq_ = std::unique_ptr<ProductQuantizer>(new ProductQuantizer(nbits));
   pq_->load(in);
   if (qnorm_) {
     norm_codes_ = std::vector<uint8_t>(m_);
@@ -116,6 +380,11 @@ void QuantMatrix::load(std::istream& in) {
     npq_ = std::unique_ptr<ProductQuantizer>(new ProductQuantizer());
     npq_->load(in);
   }
+  rotation_.reset();
+  if (flags & kRotation) {
+    rotation_ = std::unique_ptr<DenseMatrix>(new DenseMatrix());
+    rotation_->load(in);
+  }
 }
 
 void QuantMatrix::dump(std::ostream&) const {
@@ -29,6 +29,9 @@ class QuantMatrix : public Matrix {
  protected:
   std::unique_ptr<ProductQuantizer> pq_;
   std::unique_ptr<ProductQuantizer> npq_;
+  // Orthogonal rotation applied to the rows before quantization (OPQ), or
+  // null. The codes are those of the rotated rows.
+  std::unique_ptr<DenseMatrix> rotation_;
 
   std::vector<uint8_t> codes_;
   std::vector<uint8_t> norm_codes_;
@@ -38,21 +41,31 @@ class QuantMatrix : public Matrix {
 
  public:
   QuantMatrix();
-  QuantMatrix(DenseMatrix&&, int32_t, bool);
+  QuantMatrix(
+      DenseMatrix&&,
+      int32_t,
+      bool,
+      int32_t thread = 1,
+      int32_t nbits = 8,
+      bool opq = false);
   QuantMatrix(const QuantMatrix&) = delete;
   QuantMatrix(QuantMatrix&&) = delete;
   QuantMatrix& operator=(const QuantMatrix&) = delete;
   QuantMatrix& operator=(QuantMatrix&&) = delete;
   virtual ~QuantMatrix() noexcept override = default;
 
-  void quantizeNorm(const Vector&);
-  void quantize(DenseMatrix&& mat);
+  void quantizeNorm(const Vector&, int32_t thread = 1);
+  void trainRotation(const DenseMatrix&, int32_t thread = 1);
+  void rotate(const Vector&, Vector&) const;
+  void unrotate(const Vector&, Vector&) const;
+  void quantize(DenseMatrix&& mat, int32_t thread = 1);
 
   real dotRow(const Vector&, int64_t) const override;
+  void dotRowsToVector(Vector& x, const Vector& vec) const override;
   void addVectorToRow(const Vector&, int64_t, real) override;
   void addRowToVector(Vector& x, int32_t i) const override;
   void addRowToVector(Vector& x, int32_t i, real a) const override;
-  void averageRowsToVector(Vector& x, const std::vector<int32_t>& rows) const override;
+  void averageRowsToVector(Vector& x, Span<const int32_t> rows) const override;
   void save(std::ostream&) const override;
   void load(std::istream&) override;
   void dump(std::ostream&) const override;
@@ -0,0 +1,44 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#if defined(__AVX512F__) || defined(__AVX__) || defined(__SSE__)
+#include <immintrin.h>
+#endif
+
+namespace fasttext {
+
+/* Abstract over AVX512F, AVX, and SSE intrinsics, using the one available on this machine. */
+#if defined(__AVX512F__)
+using Register = __m512;
+inline Register Add(Register first, Register second) { return _mm512_add_ps(first, second); }
+inline Register Subtract(Register first, Register second) { return _mm512_sub_ps(first, second); }
+inline Register Set1(float to) { return _mm512_set1_ps(to); }
+inline Register Multiply(Register first, Register second) { return _mm512_mul_ps(first, second); }
+inline Register LoadU(const float* from) { return _mm512_loadu_ps(from); }
+inline void StoreU(float* to, Register value) { _mm512_storeu_ps(to, value); }
+#elif defined(__AVX__)
+using Register = __m256;
+inline Register Add(Register first, Register second) { return _mm256_add_ps(first, second); }
+inline Register Subtract(Register first, Register second) { return _mm256_sub_ps(first, second); }
+inline Register Set1(float to) { return _mm256_set1_ps(to); }
+inline Register Multiply(Register first, Register second) { return _mm256_mul_ps(first, second); }
+inline Register LoadU(const float* from) { return _mm256_loadu_ps(from); }
+inline void StoreU(float* to, Register value) { _mm256_storeu_ps(to, value); }
+#elif defined(__SSE__)
+using Register = __m128;
+inline Register Add(Register first, Register second) { return _mm_add_ps(first, second); }
+inline Register Subtract(Register first, Register second) { return _mm_sub_ps(first, second); }
+inline Register Set1(float to) { return _mm_set1_ps(to); }
+inline Register Multiply(Register first, Register second) { return _mm_mul_ps(first, second); }
+inline Register LoadU(const float* from) { return _mm_loadu_ps(from); }
+inline void StoreU(float* to, Register value) { _mm_storeu_ps(to, value); }
+#endif
+
+} // namespace fasttext
@@ -0,0 +1,93 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "sketch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <stdexcept>
+
+namespace fasttext {
+
+CountMinSketch::CountMinSketch(int64_t size, int32_t depth)
+    : width_(size / (depth * int64_t(sizeof(uint32_t)))),
+      depth_(depth),
+      total_(0) {
+  if (depth_ <= 0 || width_ <= 0) {
+    throw std::invalid_argument("Count-min sketch is too small!");
+  }
+  counters_.assign(width_ * depth_, 0);
+}
+
+// Mixes the key with the row (the finalizer of splitmix64), so that each row
+// spreads the keys differently.
+int64_t CountMinSketch::index(uint32_t h, int32_t row) const {
+  uint64_t x = (uint64_t(row) << 32) | h;
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return row * width_ + int64_t(x % uint64_t(width_));
+}
+
+uint32_t CountMinSketch::add(uint32_t h) {
+  total_++;
+  uint32_t value = estimate(h);
+  if (value == std::numeric_limits<uint32_t>::max()) {
+    return value;
+  }
+  value++;
+  for (int32_t row = 0; row < depth_; row++) {
+    uint32_t& counter = counters_[index(h, row)];
+    counter = std::max(counter, value);
+  }
+  return value;
+}
+
+uint32_t CountMinSketch::estimate(uint32_t h) const {
+  uint32_t value = std::numeric_limits<uint32_t>::max();
+  for (int32_t row = 0; row < depth_; row++) {
+    value = std::min(value, counters_[index(h, row)]);
+  }
+  return value;
+}
+
+int64_t CountMinSketch::width() const {
+  return width_;
+}
+
+int32_t CountMinSketch::depth() const {
+  return depth_;
+}
+
+int64_t CountMinSketch::size() const {
+  return counters_.size() * sizeof(uint32_t);
+}
+
+double CountMinSketch::errorBound() const {
+  return std::exp(1.0) / width_ * total_;
+}
+
+double CountMinSketch::confidence() const {
+  return 1.0 - std::exp(-double(depth_));
+}
+
+double CountMinSketch::meanError(int32_t samples) const {
+  std::minstd_rand rng(1);
+  std::uniform_int_distribution<uint32_t> uniform;
+  double sum = 0.0;
+  for (int32_t i = 0; i < samples; i++) {
+    sum += estimate(uniform(rng));
+  }
+  return samples > 0 ? sum / samples : 0.0;
+}
+
+} // namespace fasttext
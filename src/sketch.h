@@ -0,0 +1,52 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace fasttext {
+
+/**
+ * Counts hashed keys in a fixed amount of memory: a count-min sketch, made of
+ * depth rows of width counters, each row indexing a key with a hash of its
+ * own. The estimate of a key is its smallest counter, which is never below
+ * its count and, with probability 1 - exp(-depth), exceeds it by at most
+ * e / width times the number of occurrences added.
+ */
+class CountMinSketch {
+ protected:
+  int64_t width_;
+  int32_t depth_;
+  std::vector<uint32_t> counters_;
+  int64_t total_;
+
+  int64_t index(uint32_t h, int32_t row) const;
+
+ public:
+  // Uses about size bytes.
+  CountMinSketch(int64_t size, int32_t depth);
+
+  // Adds an occurrence of the key h, raising only the counters of h that are
+  // below its new estimate (conservative update), and returns this estimate.
+  uint32_t add(uint32_t h);
+  uint32_t estimate(uint32_t h) const;
+
+  int64_t width() const;
+  int32_t depth() const;
+  int64_t size() const;
+  // The bound on the overestimate of a key, and the probability that it holds.
+  double errorBound() const;
+  double confidence() const;
+  // The mean estimate of samples random keys, which have most likely never
+  // been added: how much a count is typically overestimated.
+  double meanError(int32_t samples) const;
+};
+
+} // namespace fasttext
@@ -0,0 +1,56 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+namespace fasttext {
+
+/**
+ * A view of size elements stored contiguously, which does not own them; it
+ * stands in for std::span until the library requires C++20.
+ */
+template <typename T>
+class Span {
+ protected:
+  T* data_;
+  size_t size_;
+
+ public:
+  Span() : data_(nullptr), size_(0) {}
+  Span(T* data, size_t size) : data_(data), size_(size) {}
+  Span(T* begin, T* end) : data_(begin), size_(end - begin) {}
+  // Implicit, so that a vector can be passed where a span is expected.
+  template <typename U>
+  Span(const std::vector<U>& v) : data_(v.data()), size_(v.size()) {}
+
+  T* data() const {
+    return data_;
+  }
+  size_t size() const {
+    return size_;
+  }
+  bool empty() const {
+    return size_ == 0;
+  }
+  T* begin() const {
+    return data_;
+  }
+  T* end() const {
+    return data_ + size_;
+  }
+  T& operator[](size_t i) const {
+    assert(i < size_);
+    return data_[i];
+  }
+};
+
+} // namespace fasttext
@@ -12,8 +12,10 @@
 
 #include <algorithm>
 #include <chrono>
+#include <exception>
 #include <fstream>
 #include <ostream>
+#include <thread>
 #include <vector>
 
 #if defined(__clang__) || defined(__GNUC__)
@@ -52,6 +54,50 @@ bool containsSecond(
              }) != container.end();
 }
 
+// Calls f(t, begin, end) on contiguous ranges of [0, n), the range t on a
+// thread of its own, so that f can fill a buffer per range. Returns the number
+// of ranges, which is at most thread. An exception thrown by f is rethrown
+// once all the ranges are done, that of the first range if several threw.
+template <typename F>
+int32_t parallelForThreads(int64_t n, int32_t thread, F f) {
+  thread = std::max<int64_t>(1, std::min<int64_t>(thread, n));
+  if (thread > 1) {
+    std::vector<std::thread> threads;
+    std::vector<std::exception_ptr> errors(thread);
+    for (int32_t t = 0; t < thread; t++) {
+      int64_t begin = n * t / thread;
+      int64_t end = n * (t + 1) / thread;
+      threads.push_back(std::thread([=, &f, &errors]() {
+        try {
+          f(t, begin, end);
+        } catch (...) {
+          errors[t] = std::current_exception();
+        }
+      }));
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    for (const auto& error : errors) {
+      if (error) {
+        std::rethrow_exception(error);
+      }
+    }
+  } else {
+    // webassembly can't instantiate `std::thread`
+    f(0, 0, n);
+  }
+  return thread;
+}
+
+// Calls f(begin, end) on contiguous ranges of [0, n), one range per thread.
+template <typename F>
+void parallelFor(int64_t n, int32_t thread, F f) {
+  parallelForThreads(n, thread, [&f](int32_t, int64_t begin, int64_t end) {
+    f(begin, end);
+  });
+}
+
 double getDuration(
     const std::chrono::steady_clock::time_point& start,
     const std::chrono::steady_clock::time_point& end);
@@ -0,0 +1,303 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "wordvectors.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+
+#include "utils.h"
+
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<charconv>)
+#include <charconv>
+#endif
+#endif
+
+namespace fasttext {
+
+constexpr int32_t VECTORS_VERSION = 1;
+constexpr int32_t VECTORS_FILEFORMAT_MAGIC_INT32 = 793712316;
+
+inline bool isBlank(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+inline bool isBlankLine(const char* p, const char* end) {
+  return std::all_of(p, end, isBlank);
+}
+
+// Parses the value starting at p, which is followed by a newline at the
+// latest, and returns the first character after it, or nullptr.
+inline const char* parseReal(const char* p, const char* end, real& value) {
+  if (p < end && *p == '+') {
+    p++;
+  }
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+  auto result = std::from_chars(p, end, value);
+  if (result.ec == std::errc::result_out_of_range) {
+    // strtof gives the closest value, e.g. a denormal or 0 on underflow
+    value = std::strtof(p, nullptr);
+  }
+  return result.ptr == p ? nullptr : result.ptr;
+#else
+  char* next;
+  value = std::strtof(p, &next);
+  return next == p ? nullptr : next;
+#endif
+}
+
+// A line is a word followed by dim values, separated by blanks; end is after
+// its newline and the blank lines that follow it, if any.
+bool parseLine(
+    const char* p,
+    const char* end,
+    std::string& word,
+    real* values,
+    int64_t dim) {
+  while (p < end && isBlank(*p)) {
+    p++;
+  }
+  const char* begin = p;
+  while (p < end && !isBlank(*p) && *p != '\n') {
+    p++;
+  }
+  if (p == begin) {
+    return false;
+  }
+  word.assign(begin, p);
+  for (int64_t j = 0; j < dim; j++) {
+    while (p < end && isBlank(*p)) {
+      p++;
+    }
+    p = parseReal(p, end, values[j]);
+    if (!p) {
+      return false;
+    }
+  }
+  return std::all_of(p, end, [](char c) { return isBlank(c) || c == '\n'; });
+}
+
+WordVectors::WordVectors(
+    const std::string& filename,
+    int64_t dim,
+    int32_t thread)
+    : words_(), matrix_() {
+  std::ifstream in(filename, std::ifstream::binary);
+  if (!in.is_open()) {
+    throw std::invalid_argument(filename + " cannot be opened for loading!");
+  }
+  if (isBinary(filename)) {
+    loadBinary(in, dim);
+  } else {
+    loadText(in, dim, thread);
+  }
+}
+
+bool WordVectors::isBinary(const std::string& filename) {
+  std::ifstream ifs(filename, std::ifstream::binary);
+  int32_t magic = 0;
+  ifs.read((char*)&magic, sizeof(int32_t));
+  return ifs && magic == VECTORS_FILEFORMAT_MAGIC_INT32;
+}
+
+void WordVectors::checkDimension(int64_t dim, int64_t expected) const {
+  if (dim != expected) {
+    throw std::invalid_argument(
+        "Dimension of pretrained vectors (" + std::to_string(dim) +
+        ") does not match dimension (" + std::to_string(expected) + ")!");
+  }
+}
+
+void WordVectors::loadBinary(std::istream& in, int64_t dim) {
+  int32_t magic, version;
+  int64_t count, vectorDim;
+  in.read((char*)&magic, sizeof(int32_t));
+  in.read((char*)&version, sizeof(int32_t));
+  in.read((char*)&count, sizeof(int64_t));
+  in.read((char*)&vectorDim, sizeof(int64_t));
+  if (!in || magic != VECTORS_FILEFORMAT_MAGIC_INT32) {
+    throw std::invalid_argument("Pretrained vectors file has no header!");
+  }
+  if (version > VECTORS_VERSION) {
+    throw std::invalid_argument("Unsupported word vectors version!");
+  }
+  checkDimension(vectorDim, dim);
+  if (count < 0 || vectorDim <= 0) {
+    throw std::invalid_argument("Invalid pretrained vectors header!");
+  }
+  // Each vector takes its values and at least the null byte ending its word,
+  // which bounds the count by the size of the file before allocating.
+  in.seekg(0, std::ios_base::end);
+  int64_t payload = int64_t(in.tellg()) - kBinaryHeaderSize;
+  if (!in || payload < 0 ||
+      count > payload / (vectorDim * int64_t(sizeof(real)) + 1)) {
+    throw std::invalid_argument("Pretrained vectors file is truncated!");
+  }
+  in.seekg(kBinaryHeaderSize);
+  matrix_ = std::make_shared<DenseMatrix>(count, vectorDim);
+  in.read((char*)matrix_->data(), count * vectorDim * sizeof(real));
+  words_.resize(count);
+  for (auto& word : words_) {
+    std::getline(in, word, '\0');
+  }
+  // the last word was cut if the end of the file came before its null byte
+  if (!in || in.eof()) {
+    throw std::invalid_argument("Pretrained vectors file is truncated!");
+  }
+}
+
+void WordVectors::loadText(std::istream& in, int64_t dim, int32_t thread) {
+  int64_t count, vectorDim;
+  in >> count >> vectorDim;
+  if (!in) {
+    throw std::invalid_argument("Pretrained vectors file has no header!");
+  }
+  checkDimension(vectorDim, dim);
+  in.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+  words_.resize(count);
+  matrix_ = std::make_shared<DenseMatrix>(count, vectorDim);
+
+  // The file is read in blocks, and the complete lines of each block are
+  // parsed on several threads, the last partial line being carried over to
+  // the next block. Blank lines are skipped, their newline being left at the
+  // end of the previous line, after its values.
+  std::vector<char> block;
+  std::vector<const char*> lines;
+  int64_t row = 0;
+  int64_t line = 1;
+  while (row < count && in) {
+    size_t carried = block.size();
+    block.resize(carried + kBlockSize);
+    in.read(block.data() + carried, kBlockSize);
+    block.resize(carried + in.gcount());
+    if (!in && !block.empty() && block.back() != '\n') {
+      block.push_back('\n');
+    }
+    lines.clear();
+    const char* begin = block.data();
+    const char* end = begin + block.size();
+    const char* p = begin;
+    while (row + int64_t(lines.size()) < count) {
+      const char* newline = (const char*)std::memchr(p, '\n', end - p);
+      if (!newline) {
+        break;
+      }
+      if (!isBlankLine(p, newline)) {
+        lines.push_back(p);
+      }
+      p = newline + 1;
+    }
+    lines.push_back(p);
+    int64_t bad = parseLines(lines, row, thread);
+    if (bad >= 0) {
+      line += std::count(begin, lines[bad], '\n') + 1;
+      throw std::invalid_argument(
+          "Line " + std::to_string(line) +
+          " of the pretrained vectors could not be parsed!");
+    }
+    line += std::count(begin, p, '\n');
+    row += lines.size() - 1;
+    block.erase(block.begin(), block.begin() + (p - begin));
+  }
+  if (row < count) {
+    throw std::invalid_argument(
+        "Pretrained vectors file has " + std::to_string(row) +
+        " vectors instead of " + std::to_string(count) + "!");
+  }
+}
+
+// Returns the index of the first line that could not be parsed, or -1.
+int64_t WordVectors::parseLines(
+    const std::vector<const char*>& lines,
+    int64_t firstRow,
+    int32_t thread) {
+  const int64_t n = lines.size() - 1;
+  const int64_t dim = matrix_->cols();
+  auto parse = [&](int64_t begin, int64_t end) -> int64_t {
+    for (int64_t i = begin; i < end; i++) {
+      real* values = matrix_->data() + (firstRow + i) * dim;
+      std::string& word = words_[firstRow + i];
+      if (!parseLine(lines[i], lines[i + 1], word, values, dim)) {
+        return i;
+      }
+    }
+    return -1;
+  };
+  thread = std::max<int64_t>(1, std::min<int64_t>(thread, n));
+  if (thread == 1) {
+    // webassembly can't instantiate `std::thread`
+    return parse(0, n);
+  }
+  std::vector<int64_t> bad(thread, -1);
+  std::vector<std::thread> threads;
+  for (int32_t t = 0; t < thread; t++) {
+    threads.push_back(std::thread([&, t]() {
+      bad[t] = parse(n * t / thread, n * (t + 1) / thread);
+    }));
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  for (auto i : bad) {
+    if (i >= 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+void WordVectors::saveBinary(
+    std::ostream& out,
+    int64_t count,
+    int64_t dim,
+    const std::function<std::string(int64_t)>& getWord,
+    const std::function<void(int64_t, Vector&)>& getVector,
+    int32_t thread) {
+  const int32_t magic = VECTORS_FILEFORMAT_MAGIC_INT32;
+  const int32_t version = VECTORS_VERSION;
+  std::vector<char> header(kBinaryHeaderSize, 0);
+  std::memcpy(header.data(), &magic, sizeof(int32_t));
+  std::memcpy(header.data() + 4, &version, sizeof(int32_t));
+  std::memcpy(header.data() + 8, &count, sizeof(int64_t));
+  std::memcpy(header.data() + 16, &dim, sizeof(int64_t));
+  out.write(header.data(), header.size());
+  const int64_t chunkSize =
+      std::max<int64_t>(1, kBlockSize / (dim * sizeof(real)));
+  std::vector<real> values(std::min(count, chunkSize) * dim);
+  for (int64_t chunk = 0; chunk < count; chunk += chunkSize) {
+    const int64_t size = std::min(chunkSize, count - chunk);
+    utils::parallelFor(size, thread, [&](int64_t begin, int64_t end) {
+      Vector vec(dim);
+      for (auto i = begin; i < end; i++) {
+        getVector(chunk + i, vec);
+        std::copy(vec.data(), vec.data() + dim, values.data() + i * dim);
+      }
+    });
+    out.write((char*)values.data(), size * dim * sizeof(real));
+  }
+  for (int64_t i = 0; i < count; i++) {
+    std::string word = getWord(i);
+    out.write(word.c_str(), word.size() + 1);
+  }
+}
+
+const std::vector<std::string>& WordVectors::getWords() const {
+  return words_;
+}
+
+std::shared_ptr<const DenseMatrix> WordVectors::getMatrix() const {
+  return matrix_;
+}
+
+} // namespace fasttext
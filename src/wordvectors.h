@@ -0,0 +1,66 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "densematrix.h"
+#include "vector.h"
+
+namespace fasttext {
+
+/**
+ * Word vectors stored apart from a model, either as text (.vec) with a
+ * "<count> <dim>" line followed by one word and its values per line, or in a
+ * binary format (.bvec): a header padded to kBinaryHeaderSize bytes, the
+ * values of all the vectors stored contiguously, so that they can be mapped
+ * as they are, and then the words, each followed by a null byte.
+ */
+class WordVectors {
+ protected:
+  static const int64_t kBinaryHeaderSize = 64;
+  static const int64_t kBlockSize = 1 << 24;
+
+  std::vector<std::string> words_;
+  std::shared_ptr<DenseMatrix> matrix_;
+
+  void loadText(std::istream& in, int64_t dim, int32_t thread);
+  void loadBinary(std::istream& in, int64_t dim);
+  void checkDimension(int64_t dim, int64_t expected) const;
+  int64_t parseLines(
+      const std::vector<const char*>& lines,
+      int64_t firstRow,
+      int32_t thread);
+
+ public:
+  // Text files are parsed on several threads; dim is the dimension the
+  // vectors are expected to have. saveBinary calls getVector from several
+  // threads at a time.
+  WordVectors(const std::string& filename, int64_t dim, int32_t thread);
+
+  static bool isBinary(const std::string& filename);
+  static void saveBinary(
+      std::ostream& out,
+      int64_t count,
+      int64_t dim,
+      const std::function<std::string(int64_t)>& getWord,
+      const std::function<void(int64_t, Vector&)>& getVector,
+      int32_t thread = 1);
+
+  const std::vector<std::string>& getWords() const;
+  std::shared_ptr<const DenseMatrix> getMatrix() const;
+};
+
+} // namespace fasttext
@@ -53,11 +53,14 @@ class FastText {
    *
    * @param {string}     url
    *     the url of the model file.
+   * @param {string}     half
+   *     'fp16' or 'bf16' to store the matrices of a float model in half
+   *     precision, or '' to keep them as they are saved.
    *
    * @return {Promise}   promise object that resolves to a `FastTextModel`
    *
    */
-  loadModel(url) {
+  loadModel(url, half = '') {
     const fetchFunc = (thisModule && thisModule.fetch) || fetch;
 
     const fastTextNative = this.f;
@@ -69,7 +72,7 @@ class FastText {
         const FS = fastTextModule.FS;
         FS.writeFile(modelFileInWasmFs, byteArray);
       }).then(() =>  {
-        fastTextNative.loadModel(modelFileInWasmFs);
+        fastTextNative.loadModel(modelFileInWasmFs, half, 1);
         resolve(new FastTextModel(fastTextNative));
       }).catch(error => {
         reject(error);
@@ -90,10 +93,11 @@ class FastText {
         FS.writeFile(trainFileInWasmFs, byteArray);
       }).then(() =>  {
         const argsList = ['lr', 'lrUpdateRate', 'dim', 'ws', 'epoch',
-          'minCount', 'minCountLabel', 'neg', 'wordNgrams', 'loss',
+          'minCount', 'minCountLabel', 'vocabSketch', 'neg', 'wordNgrams', 'loss',
           'model', 'bucket', 'minn', 'maxn', 't', 'label', 'verbose',
-          'pretrainedVectors', 'saveOutput', 'seed', 'qout', 'retrain',
-          'qnorm', 'cutoff', 'dsub', 'qnorm', 'autotuneValidationFile',
+          'pretrainedVectors', 'saveOutput', 'binaryVectors', 'compress', 'seed', 'checkpoint',
+          'checkpointInterval', 'checkpointTokens', 'resume', 'inputModel', 'qout', 'retrain',
+          'qnorm', 'cutoff', 'dsub', 'nbits', 'opq', 'int8', 'half', 'qnorm', 'autotuneValidationFile',
           'autotuneMetric', 'autotunePredictions', 'autotuneDuration',
           'autotuneModelSize'];
         const args = new fastTextModule.Args();
@@ -465,7 +469,7 @@ class FastTextModel {
      *
      */
   saveModel() {
-    this.f.saveModel(modelFileInWasmFs);
+    this.f.saveModel(modelFileInWasmFs, false);
     const content = fastTextModule.FS.readFile(modelFileInWasmFs,
       { encoding: 'binary' });
     return new Blob(
@@ -194,6 +194,7 @@ EMSCRIPTEN_BINDINGS(fasttext) {
       .property("epoch", &Args::epoch)
       .property("minCount", &Args::minCount)
       .property("minCountLabel", &Args::minCountLabel)
+      .property("vocabSketch", &Args::vocabSketch)
       .property("neg", &Args::neg)
       .property("wordNgrams", &Args::wordNgrams)
       .property("loss", &Args::loss)
@@ -207,24 +208,39 @@ EMSCRIPTEN_BINDINGS(fasttext) {
       .property("verbose", &Args::verbose)
       .property("pretrainedVectors", &Args::pretrainedVectors)
       .property("saveOutput", &Args::saveOutput)
+      .property("binaryVectors", &Args::binaryVectors)
+      .property("compress", &Args::compress)
       .property("seed", &Args::seed)
+      .property("checkpoint", &Args::checkpoint)
+      .property("checkpointInterval", &Args::checkpointInterval)
+      .property("checkpointTokens", &Args::checkpointTokens)
+      .property("resume", &Args::resume)
+      .property("inputModel", &Args::inputModel)
       .property("qout", &Args::qout)
       .property("retrain", &Args::retrain)
       .property("qnorm", &Args::qnorm)
       .property("cutoff", &Args::cutoff)
       .property("dsub", &Args::dsub)
+      .property("nbits", &Args::nbits)
+      .property("opq", &Args::opq)
+      .property("int8", &Args::int8)
+      .property("half", &Args::half)
       .property("qnorm", &Args::qnorm)
       .property("autotuneValidationFile", &Args::autotuneValidationFile)
       .property("autotuneMetric", &Args::autotuneMetric)
       .property("autotunePredictions", &Args::autotunePredictions)
       .property("autotuneDuration", &Args::autotuneDuration)
+      .property("autotuneParallel", &Args::autotuneParallel)
+      .property("autotuneEarlyStopping", &Args::autotuneEarlyStopping)
       .property("autotuneModelSize", &Args::autotuneModelSize);
 
   class_<FastText>("FastText")
       .constructor<>()
       .function(
           "loadModel",
-          select_overload<void(const std::string&)>(&FastText::loadModel))
+          select_overload<void(
+              const std::string&, const std::string&, int32_t)>(
+              &FastText::loadModel))
       .function(
           "getNN",
           select_overload<std::vector<std::pair<real, std::string>>(
@@ -244,7 +260,9 @@ EMSCRIPTEN_BINDINGS(fasttext) {
       .function("getSubwords", &getSubwords, allow_raw_pointers())
       .function("getInputVector", &getInputVector, allow_raw_pointers())
       .function("train", &train, allow_raw_pointers())
-      .function("saveModel", &FastText::saveModel)
+      .function(
+          "saveModel",
+          select_overload<void(const std::string&, bool)>(&FastText::saveModel))
       .property("isQuant", &FastText::isQuant)
       .property("args", &FastText::getArgs);
 